@@ -17,7 +17,8 @@ PYBIND11_MODULE(qclient, m) {
  
     py::class_<FutureWrapper<Client>>(m, "FutureWrapper")
         .def("get", &FutureWrapper<Client>::get)
-        .def("valid", &FutureWrapper<Client>::valid);
+        .def("valid", &FutureWrapper<Client>::valid)
+        .def_property_readonly("job_id", &FutureWrapper<Client>::job_id);
 
     py::class_<Client>(m, "QClient")
  
@@ -33,6 +34,10 @@ PYBIND11_MODULE(qclient, m) {
 
         .def("send_parameters", [](Client &c, const std::string& parameters) { 
             return FutureWrapper<Client>(c.send_parameters(parameters)); 
+        })
+
+        .def("cancel", [](Client &c, const std::string& job_id) { 
+            c.cancel(job_id); 
         });
 
     m.def("qasm2_to_json", [](const std::string& circuit_qasm) {
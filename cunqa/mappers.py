@@ -98,7 +98,8 @@ class QJobMapper:
         given jobs. Regarding the *population*, each set of parameters will be assigned to each 
         :py:class:`~cunqa.qjob.QJob` object, so the list must have size (*N,p*), being *N* the 
         lenght of :py:attr:`~cunqa.mappers.QJobMapper.qjobs` and *p* the number of parameters in the 
-        circuit. Mainly, this is thought for the function to take a :py:class:`~cunqa.result.Result` 
+        circuit. A bigger population is split among the jobs, each one sending its share as a single 
+        batch to its vQPU. Mainly, this is thought for the function to take a :py:class:`~cunqa.result.Result` 
         object and to return a value. For example, the function can evaluate the expected value of 
         an observable from the output of the circuit.
 
@@ -112,11 +113,22 @@ class QJobMapper:
             List of outputs of the function applied to the results of each job for the given 
             population.
         """
-        qjobs_ = []
-        for qjob, params in zip(self.qjobs, population):
-            qjob.upgrade_parameters(list(params))
-            qjobs_.append(qjob)
-        results = gather(qjobs_) # we only gather the qjobs we upgraded.
+        population = [list(params) for params in population]
+        if len(population) <= len(self.qjobs):
+            qjobs_ = []
+            for qjob, params in zip(self.qjobs, population):
+                qjob.upgrade_parameters(params)
+                qjobs_.append(qjob)
+            results = gather(qjobs_) # we only gather the qjobs we upgraded.
+            return [func(result) for result in results]
+
+        # More sets than jobs: each job gets a contiguous share of the population as a batch, 
+        # which its vQPU runs in a single round trip
+        n_qjobs = len(self.qjobs)
+        bounds = [len(population) * i // n_qjobs for i in range(n_qjobs + 1)]
+        for qjob, begin, end in zip(self.qjobs, bounds[:-1], bounds[1:]):
+            qjob.upgrade_parameters(population[begin:end])
+        results = [result for batch in gather(self.qjobs) for result in batch]
         return [func(result) for result in results]
 
 
@@ -203,7 +215,8 @@ class QPUCircuitMapper:
         QPUs after assigning them *population*. Regarding the *population*, each set of parameters 
         will be assigned to each circuit, so the list must have size (*N,p*), being *N* the lenght 
         of :py:attr:`~cunqa.mappers.QJobMapper.qpus` and *p* the number of parameters in the circuit.
-        Mainly, this is thought for the function to take a :py:class:`~cunqa.result.Result` object 
+        For a :py:class:`~cunqa.circuit.CunqaCircuit`, a bigger population is shared round robin 
+        among the QPUs, each one receiving its sets in a single batch. Mainly, this is thought for the function to take a :py:class:`~cunqa.result.Result` object 
         and to return a value. For example, the function can evaluate the expected value of an 
         observable from the output of the circuit.
 
@@ -232,15 +245,24 @@ class QPUCircuitMapper:
                 raise RuntimeError(f"Error while assigning parameters to Qiskit's QuantumCircuit: {error}.")
         elif isinstance(self.circuit, CunqaCircuit):
             try:
+                # Sets go round robin to the QPUs, and those that get more than one receive them 
+                # all in a single batch
+                population = list(population)
                 for i, params in enumerate(population):
-                    qpu = self.qpus[i % len(self.qpus)]
                     if not isinstance(params, list):
                         try:
-                            params = params.tolist()
+                            population[i] = params.tolist()
                         except Exception as error:
                             raise RuntimeError(f"Cannot convert {type(params)} to list.")
-                    qjobs.append(run(self.circuit, qpu, params, **self.run_parameters))
-                results = gather(qjobs)
+                n_qpus = min(len(self.qpus), len(population))
+                for i in range(n_qpus):
+                    param_sets = population[i::n_qpus]
+                    param_values = param_sets[0] if len(param_sets) == 1 else param_sets
+                    qjobs.append(run(self.circuit, self.qpus[i], param_values, **self.run_parameters))
+
+                results = [None] * len(population)
+                for i, result in enumerate(gather(qjobs)):
+                    results[i::n_qpus] = result if isinstance(result, list) else [result]
                 return [func(result) for result in results]
             except Exception as error:
                 raise RuntimeError(f"Error while assigning parameters to CUNQA's CunqaCircuit: {error}.")
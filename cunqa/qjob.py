@@ -21,6 +21,7 @@
     """
 
 import json
+import re
 from typing import  Optional, Any, Union
 
 from cunqa.logger import logger
@@ -30,6 +31,18 @@ from sympy import Symbol
 from cunqa.circuit.parameter import encoder, Param
 from cunqa.real_qpus.qmioclient import QMIOClient, QMIOFuture
 
+# Constants and functions that the vQPUs understand in a parameter expression, apart from the 
+# arithmetic operators and the free variables of the circuit
+_EXPRESSION_NAMES = {"pi", "E", "sin", "cos", "tan", "asin", "acos", "atan", "sinh", "cosh", "tanh", 
+                     "exp", "log", "sqrt", "Abs"}
+# Names in a printed expression, skipping the exponent of numbers like 1.5e-3
+_EXPRESSION_NAME = re.compile(r"(?<![\w.])[A-Za-z_]\w*")
+
+def _is_batch(param_values) -> bool:
+    """Whether the values are a list of parameter sets rather than a single one."""
+    return (isinstance(param_values, (list, tuple)) and len(param_values) > 0 and 
+            all(hasattr(params, "__len__") and not isinstance(params, str) for params in param_values))
+
 class QJob:
     """
     Class to handle jobs sent to vQPUs. A :py:class:`QJob` object is created as the output 
@@ -53,6 +66,11 @@ class QJob:
 
     .. automethod:: upgrade_parameters
 
+    Jobs that are no longer needed, e.g. a parameter point abandoned by an optimizer, can be 
+    dropped from the vQPU with the :py:meth:`~QJob.cancel` method.
+
+    .. automethod:: cancel
+
     *References*:
 
     .. [#] `Variational Quantum Algorithms arXiv <https://arxiv.org/abs/2012.09265>`_ .
@@ -65,8 +83,11 @@ class QJob:
     _device: dict
     _future: Union[FutureWrapper, QMIOFuture] 
     _result: Optional[Result]
+    _cancelled: bool
     _quantum_task: dict
     _params: list[Param]
+    _variables: list[str]
+    _pending_variables: Optional[dict]
 
     def __init__(
             self, 
@@ -83,6 +104,7 @@ class QJob:
         self._updated = False
         self._future = None
         self._result = None
+        self._cancelled = False
 
         run_config = {
             "shots": 1024, 
@@ -108,14 +130,25 @@ class QJob:
             "is_dynamic": circuit_ir["is_dynamic"],
             "id": circuit_ir["id"][1]
         }
+
+        # With the expressions of the parameters the vQPU can evaluate them itself, so updates 
+        # that give a value to every variable only need to send the variables
+        self._variables = self._expression_variables_()
+        self._pending_variables = None
+        if self._variables:
+            self._quantum_task["param_expressions"] = {
+                "variables": self._variables,
+                "expressions": [str(param.expr) for param in self._params]
+            }
       
         logger.debug("Qjob configured")
 
     @property
-    def result(self) -> Result:
+    def result(self) -> Union[Result, list[Result]]:
         """
         Result of the job. If no error occured during simulation, a :py:class:`~cunqa.result.Result` 
-        object is retured.
+        object is retured. For a batch of parameter sets, a list with the result of each set is 
+        returned instead.
 
             >>> qjob = qpu.run(circuit)
             >>> result = qjob.result
@@ -127,23 +160,17 @@ class QJob:
             call, which means that the program will be blocked until the :py:class:`QClient` has 
             recieved from the corresponding server the outcome of the job. The result is not sent 
             from the server to the :py:class:`QClient` until this method is called.
-        
-        .. warning::
-            Because of how the client-server comunication is built, the user must be careful and call 
-            for the results in the same order in which the jobs where submited. If the order is not 
-            respected, no errors would be raised but results will not correspond to the job -
-            a mix up would happen. This is because the server follows the FIFO rule (*First in 
-            first out*): if we want to receive the second result, the first one has to be out.
+
+        Each job is tagged with an identifier that the server sends back with its result, so 
+        results can be requested in any order, no matter the order in which the jobs finish.
 
         """
+        if self._cancelled:
+            raise RuntimeError("The job was cancelled, it has no result.")
         if self._future is not None:
             if (self._result is not None and not self._updated) or (self._result is None):
                 res = self._future.get()
-                self._result = Result(
-                    json.loads(res), 
-                    circ_id=self._circuit_id[0], 
-                    registers=self._cregisters
-                )
+                self._result = self._to_result_(json.loads(res))
                 self._updated = True
         else:
             raise RuntimeError("self._future is None which means that the QJob has not "
@@ -161,7 +188,10 @@ class QJob:
             >>> qjob.submit() # Already has all the info of where and what to send
 
         In case the circuit is parametric it needs to be called with the value of its free 
-        parameters set with the :py:attr:`param_values`.
+        parameters set with the :py:attr:`param_values`. A list of lists of values is sent as a 
+        batch: the vQPU executes the circuit once per set, and the result is the list of their 
+        results. For a batch, the `shots` run parameter can also be a list with the shots of 
+        each set.
         
         .. note::
             Opposite to :py:attr:`~cunqa.qjob.QJob.result`, this is a non-blocking call.
@@ -176,7 +206,15 @@ class QJob:
         if self._future is not None:
             logger.error("QJob has already been submitted.")
         else:
-            if param_values is not None:
+            if _is_batch(param_values):
+                shots = self._quantum_task["config"]["shots"]
+                batch_shots = list(shots) if isinstance(shots, (list, tuple)) else None
+                self._quantum_task["batch"] = self._batch_(param_values, batch_shots)
+                if batch_shots is not None:
+                    self._quantum_task["config"]["shots"] = batch_shots[0]
+                # The circuit is sent with the first set assigned, the vQPU binds each one anyway
+                self.assign_parameters_(list(param_values[0]))
+            elif param_values is not None:
                 self.assign_parameters_(param_values)
             
             self._future = self._qclient.send_circuit(
@@ -190,7 +228,8 @@ class QJob:
             
     def upgrade_parameters(
         self, 
-        param_values: Union[dict[Symbol, Union[float, int]], list[Union[float, int]]]
+        param_values: Union[dict[Symbol, Union[float, int]], list[Union[float, int]], list[list[Union[float, int]]]],
+        shots: Optional[list[int]] = None
     ) -> None:
         """
         Method to upgrade the parameters in a previously submitted job of parametric circuit.
@@ -204,9 +243,18 @@ class QJob:
         values in the order of the gates in the circuit, in which case missing parameters will
         result in an error. On the other hand, as a **dict** where the keys are the free 
         parameters names and the values the corresponding new value to that free parameter. Not 
-        all parameters need to be updated, but they must have been given a value at 
+        all parameters need to be updated, but they must have been given a value at
         least once, because its last value would be used.
 
+        When the dict gives a value to every free parameter, only those values are sent and the
+        vQPU evaluates the expressions of the gates itself, which saves both time and message size
+        for circuits where many gates depend on a few free parameters.
+
+        Several sets can be sent at once as a **list of lists**, each one ordered as a list update. 
+        The vQPU runs all of them as a single job and :py:attr:`~cunqa.qjob.QJob.result` is then the 
+        list of their results, in the same order. Optionally, *shots* gives the shots of each set. 
+        The parameters of the job are left as they were before the batch.
+
         .. warning::
             Before sending the circuit or upgrading its parameters, the result of the prior job must be 
             called. It can be done manually, so that we can save it and obtain its information, or it 
@@ -218,13 +266,14 @@ class QJob:
                                         parametrized circuit or a dictionary with keys being the 
                                         free parameters' names and its values being its 
                                         corresponding new values.
+            shots (list[int]): shots of each set of a batch, by default those of the job.
         """
 
-        if self._result is None: 
+        if self._result is None and not self._cancelled: 
             if self._future is not None:
                 # TODO: Improve this by having a queue of results
                 logger.warning("You have not obtained the previous results. They will be discarded.")
-                self._future.get() # we get the previous result because if not it stays in queue
+                self._future.get() # we get the previous result because if not it stays buffered in the client
             else:
                 raise RuntimeError("No circuit was sent before calling update_parameters().")
 
@@ -232,23 +281,80 @@ class QJob:
             raise AttributeError("No parameter list has been provided to the upgrade_parameters "
                                  "method.")
 
-        self.assign_parameters_(param_values)
+        if _is_batch(param_values):
+            message = json.dumps({"batch": self._batch_(param_values, shots)})
+        elif (isinstance(param_values, dict) and self._variables and 
+            all(param_values.get(name) is not None for name in self._variables)):
+            # Every parameter is evaluated again, which the vQPU does from the variables alone
+            self._pending_variables = {name: param_values[name] for name in self._variables}
+            message = json.dumps({"variables": [float(param_values[name]) for name in self._variables]})
+        else:
+            self.assign_parameters_(param_values)
+            message = None
               
         try:
-            premessage = json.dumps(self._params, default=encoder)
-            message = """{{"params":{}}}""".format(premessage).replace("'", '"')
+            if message is None:
+                premessage = json.dumps(self._params, default=encoder)
+                message = """{{"params":{}}}""".format(premessage).replace("'", '"')
             self._future = self._qclient.send_parameters(message)
             self._updated = False
+            self._cancelled = False
         except Exception as error:
             logger.error(f"Some error occured when sending the new parameters to "
                          f"circuit {self._circuit_id} [{type(error).__name__}].")
             self._updated = True
             
+    def cancel(self) -> bool:
+        """
+        Cancels the job in the vQPU. If it is still waiting in the queue of the vQPU it is 
+        dropped, and if it is being simulated the simulation stops at the next shot. Only dynamic 
+        circuits on vQPUs without communications can stop half way, the rest of simulations run 
+        until the end and their result is discarded.
+
+            >>> qjob = qpu.run(circuit)
+            >>> qjob.cancel()
+            True
+
+        Afterwards, new parameters can still be sent with :py:meth:`upgrade_parameters`.
+
+        Return:
+            ``True`` if the job was cancelled, ``False`` if it had already finished, in which case 
+            its result is available at :py:attr:`~cunqa.qjob.QJob.result`.
+        """
+        if self._future is None:
+            raise RuntimeError("No circuit was sent before calling cancel().")
+        if self._cancelled:
+            return True
+        if self._updated:
+            logger.warning("The job had already finished, there is nothing to cancel.")
+            return False
+        if not hasattr(self._qclient, "cancel"):
+            logger.warning(f"Cancelling jobs is not supported by {type(self._qclient).__name__}.")
+            return False
+
+        self._qclient.cancel(self._future.job_id)
+        res = json.loads(self._future.get()) # the vQPU answers the job either way
+        if "CANCELLED" in res or "BUSY" in res:
+            self._cancelled = True
+            self._result = None
+            logger.debug(f"Job of circuit {self._circuit_id} cancelled.")
+            return True
+
+        self._result = self._to_result_(res)
+        self._updated = True
+        return False
+
     def assign_parameters_(
         self, 
         param_values: Union[dict[Symbol, Union[float, int]], list[Union[float, int]]]
     ):
         """Fuction responsible of assigning the values to the circuit parameter."""    
+        if self._pending_variables is not None:
+            # The last values were only computed by the vQPU
+            for param in self._params:
+                param.eval(self._pending_variables)
+            self._pending_variables = None
+
         if isinstance(param_values, dict):
             for param in self._params:
                 # I filter the free parameters that are employed in the symbolic expression 
@@ -271,6 +377,42 @@ class QJob:
                 for param, value in zip(self._params, param_values):
                     param.assign_value(value)
 
+    def _batch_(self, param_sets: list, shots: Optional[list[int]] = None) -> dict:
+        """Checks the parameter sets of a batch and returns them as the vQPU expects them."""
+        if isinstance(self._qclient, QMIOClient):
+            raise NotImplementedError("Batches of parameter sets are not supported by QMIO.")
+        param_sets = [[float(value) for value in params] for params in param_sets]
+        if any(len(params) != len(self._params) for params in param_sets):
+            raise ValueError("List of parameter values is not the same as the number of "
+                             "parameters.")
+        if shots is not None and len(shots) != len(param_sets):
+            raise ValueError(f"{len(shots)} shots were given for {len(param_sets)} parameter sets.")
+        return {"params": param_sets, "shots": None if shots is None else [int(s) for s in shots]}
+
+    def _to_result_(self, res: dict) -> Union[Result, list[Result]]:
+        if "batch" in res:
+            return [Result(r, circ_id=self._circuit_id[0], registers=self._cregisters) 
+                    for r in res["batch"]]
+        return Result(res, circ_id=self._circuit_id[0], registers=self._cregisters)
+
+    def _expression_variables_(self) -> list[str]:
+        """
+        Ordered names of the free variables of the circuit if the vQPU can evaluate all its 
+        parameter expressions, an empty list otherwise.
+        """
+        if not self._params or isinstance(self._qclient, QMIOClient):
+            return []
+
+        variables = sorted({symbol.name for param in self._params for symbol in param.variables})
+        if any(_EXPRESSION_NAME.fullmatch(name) is None or name in _EXPRESSION_NAMES for name in variables):
+            return []
+
+        known_names = _EXPRESSION_NAMES | set(variables)
+        for param in self._params:
+            if not set(_EXPRESSION_NAME.findall(str(param.expr))) <= known_names:
+                return []
+        return variables
+
 
 def gather(qjobs: list[QJob]) -> list[Result]:
     """
@@ -122,7 +122,9 @@ class QPU:
         """
         Class method responsible of executing a circuit into the corresponding vQPU that this class 
         connects to. Possible instructions to add as `**run_parameters` are simulator dependant, 
-        with `shots` and `method` being the most common ones.
+        with `shots` and `method` being the most common ones. An integer `priority` (default 0) 
+        makes the vQPU run the job before the waiting jobs of lower priority, while jobs of the 
+        same priority are shared fairly among all the clients of the vQPU.
 
         Args:
             circuit_ir (dict): circuit IR to be simulated at the vQPU.
@@ -313,6 +315,13 @@ def qraise(n, t, *,
            family = None, 
            co_located = True, 
            cores = None, 
+           workers = None, 
+           max_queued_jobs = None, 
+           max_queued_mb = None, 
+           result_cache_entries = None, 
+           result_cache_mb = None, 
+           coalesce_jobs = None, 
+           shot_lanes = None, 
            mem_per_qpu = None, 
            n_nodes = None, 
            node_list = None, 
@@ -348,6 +357,23 @@ def qraise(n, t, *,
                            nodes.
         cores (str): number of cores per vQPU, the total for the SLURM job will be 
                      `n*cores`.
+        workers (int): number of tasks each vQPU executes concurrently. Only used by vQPUs 
+                       without communications.
+        max_queued_jobs (int): maximum number of tasks waiting in each vQPU. Beyond it, the vQPU 
+                               asks the client to retry later, which is done automatically.
+        max_queued_mb (int): maximum size in MB of the tasks waiting in each vQPU.
+        result_cache_entries (int): number of results each vQPU keeps to answer repeated tasks 
+                                    without simulating them again. Only tasks with a ``seed`` 
+                                    and without communications are cached. Default: no cache.
+        result_cache_mb (int): maximum size in MB of the results kept by each vQPU. Default: 64.
+        coalesce_jobs (int): maximum number of queued tasks each vQPU simulates together in a 
+                             single execution. Only used by vQPUs without communications 
+                             simulated with Aer; tasks with a ``seed`` always run on their own. 
+                             Default: 1.
+        shot_lanes (int): number of shots each vQPU with classical communications runs at the 
+                          same time, each in its own thread. The measurements sent to another 
+                          vQPU travel together, one message for all of them, so vQPUs that 
+                          communicate must use the same value. Not supported by Munich. Default: 1.
         mem_per_qpu (str): memory to allocate for each vQPU in GB, format to use is "XXG".
         n_nodes (str): number of nodes for the SLURM job.
         node_list (str): list of nodes in which the vQPUs will be deployed.
@@ -379,6 +405,20 @@ def qraise(n, t, *,
         command = command + " --co-located"
     if cores is not None:
         command = command + f" --cores={str(cores)}"
+    if workers is not None:
+        command = command + f" --workers={str(workers)}"
+    if max_queued_jobs is not None:
+        command = command + f" --max-queued-jobs={str(max_queued_jobs)}"
+    if max_queued_mb is not None:
+        command = command + f" --max-queued-mb={str(max_queued_mb)}"
+    if result_cache_entries is not None:
+        command = command + f" --result-cache-entries={str(result_cache_entries)}"
+    if result_cache_mb is not None:
+        command = command + f" --result-cache-mb={str(result_cache_mb)}"
+    if coalesce_jobs is not None:
+        command = command + f" --coalesce-jobs={str(coalesce_jobs)}"
+    if shot_lanes is not None:
+        command = command + f" --shot-lanes={str(shot_lanes)}"
     if mem_per_qpu is not None:
         command = command + f" --mem-per-qpu={str(mem_per_qpu)}G"
     if n_nodes is not None:
@@ -64,6 +64,11 @@ class Result:
             message = result["ERROR"]
             raise RuntimeError(f"Error during simulation, please check availability of QPUs, run "
                                f"arguments syntax and circuit syntax: {message}")
+        elif "CANCELLED" in result:
+            raise RuntimeError(f"The task was cancelled: {result['CANCELLED']}")
+        elif "BUSY" in result:
+            raise RuntimeError(f"The QPU kept its queue full after several retries, the task was not "
+                               f"executed: {result['BUSY']}")
         else:
             self._result = result
 
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "quantum_task.hpp"
 
@@ -17,6 +18,11 @@ class Backend {
 public:
     virtual ~Backend() = default;
     virtual inline JSON execute(const QuantumTask& quantum_task) const = 0;
+    // Executes every parameter set of a batch task at once, if the simulator can do it natively
+    virtual std::optional<JSON> execute_batch(const QuantumTask&) const { return std::nullopt; }
+    // Executes independent tasks together, returning their results in the same order, if the 
+    // simulator can do it
+    virtual std::optional<std::vector<JSON>> execute_many(const std::vector<QuantumTask>&) const { return std::nullopt; }
     virtual JSON to_json() const = 0;
 
     JSON config;
@@ -75,6 +75,7 @@ public:
     { 
         config = simple_config;
         config["noise_model"] = simple_config.noise_model; // Not in to_json() to avoid the writing on qpus.json
+        simulator_->prepare(*this);
     }
 
     SimpleBackend(SimpleBackend& simple_backend) = default;
@@ -84,6 +85,16 @@ public:
         return simulator_->execute(*this, quantum_task);
     }
 
+    inline std::optional<JSON> execute_batch(const QuantumTask& quantum_task) const override
+    {
+        return simulator_->execute_batch(*this, quantum_task);
+    }
+
+    inline std::optional<std::vector<JSON>> execute_many(const std::vector<QuantumTask>& quantum_tasks) const override
+    {
+        return simulator_->execute_many(*this, quantum_tasks);
+    }
+
     // TODO: Achieve this using the JSON adl serializer
     JSON to_json() const override 
     {
@@ -1,13 +1,27 @@
 
+#include <algorithm>
+#include <map>
 #include <unordered_map>
 #include <stack>
 #include <queue>
+#include <optional>
+#include <stdexcept>
 #include <chrono>
 #include <functional>
 #include <cstdlib>
 #include <vector>
 
+#ifdef OPENMP_IN_QC
+#include <omp.h>
+#endif
+
 #include "aer_simulator_adapter.hpp"
+#include "backends/simulators/ready_queue.hpp"
+#include "backends/simulators/shot_lanes.hpp"
+#include "backends/simulators/shot_counts.hpp"
+#include "backends/simulators/shot_errors.hpp"
+#include "backends/simulators/shot_threads.hpp"
+#include "classical_channel/shot_channel.hpp"
 
 #include "simulators/circuit_executor.hpp"
 #include "framework/config.hpp"
@@ -25,26 +39,13 @@
 
 namespace {
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
 struct TaskState {
     std::string id;
-    cunqa::JSON::const_iterator it, end;
+    std::size_t index = 0;
+    std::vector<std::size_t> peers; // Task of each QPU the circuit refers to, in the order of the circuit
+    const cunqa::CompiledCircuit* circuit = nullptr;
+    const cunqa::Instruction* it = nullptr;
+    const cunqa::Instruction* end = nullptr;
     unsigned long zero_qubit = 0;
     unsigned long zero_clbit = 0;
     bool finished = false;
@@ -54,21 +55,22 @@ struct TaskState {
 
 struct GlobalState {
     unsigned long n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::stack<uint_t>> qc_meas;
-    std::unordered_map<LocalCCIDs, std::queue<uint_t>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
+    cunqa::sim::ClassicalRegister creg;
+    std::vector<std::stack<uint_t>> qc_meas; // By task
+    std::vector<std::queue<uint_t>> local_cc_queue; // By sender * n_tasks + receiver, to mimic classical communications when executing with quantum communications
 };
 
 
-std::string execute_shot_(
+// `classical_channel` is a comm::ClassicalChannel or a lane of a comm::LaneChannel
+template <typename Channel>
+cunqa::sim::ClassicalRegister execute_shot_(
     AER::AerState* state, 
     const std::vector<cunqa::QuantumTask>& quantum_tasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
+    Channel* classical_channel,
     const bool allows_qc
 )
 {
-    std::unordered_map<std::string, TaskState> Ts;
+    std::vector<TaskState> Ts;
     GlobalState G;
 
     for (auto &quantum_task : quantum_tasks)
@@ -77,11 +79,13 @@ std::string execute_shot_(
         T.id = quantum_task.id;
         T.zero_qubit = G.n_qubits;
         T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.circuit.begin();
-        T.end = quantum_task.circuit.end();
+        T.circuit = &quantum_task.compiled();
+        T.it = T.circuit->begin();
+        T.end = T.circuit->end();
         T.blocked = false;
         T.finished = false;
-        Ts[quantum_task.id] = T;
+        T.index = Ts.size();
+        Ts.push_back(T);
         
         G.n_qubits += quantum_task.config.at("num_qubits").get<int>();
         G.n_clbits += quantum_task.config.at("num_clbits").get<int>();
@@ -91,6 +95,31 @@ std::string execute_shot_(
     if (size(quantum_tasks) > 1)
         G.n_qubits += 2;
 
+    G.creg = cunqa::sim::ClassicalRegister(G.n_clbits);
+
+    // The QPUs named by the communications, resolved once to their tasks. QPUs outside the 
+    // job are only reached through the classical channel.
+    for (auto& T : Ts) {
+        for (const auto& qpu : T.circuit->qpus()) {
+            auto peer = std::find_if(Ts.begin(), Ts.end(), [&](const TaskState& other) { return other.id == qpu; });
+            T.peers.push_back(peer != Ts.end() ? peer->index : T.index);
+        }
+    }
+    G.qc_meas.resize(Ts.size());
+    G.local_cc_queue.resize(Ts.size() * Ts.size());
+
+    cunqa::sim::ReadyQueue ready;
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            ready.push(T.index);
+    }
+    auto wake = [&](const std::size_t task) {
+        if (Ts[task].blocked) {
+            Ts[task].blocked = false;
+            ready.wake(task);
+        }
+    };
+
     auto generate_entanglement_ = [&]() {
         state->apply_reset({G.n_qubits - 1});
         state->apply_reset({G.n_qubits - 2});
@@ -99,37 +128,30 @@ std::string execute_shot_(
     };
 
 
-    std::function<void(TaskState&, const cunqa::JSON&)> apply_next_instr = 
-        [&](TaskState& T, const cunqa::JSON& instruction = {}) 
+    std::function<void(TaskState&, const cunqa::Instruction*)> apply_next_instr = 
+        [&](TaskState& T, const cunqa::Instruction* instruction = nullptr) 
     {
-        const cunqa::JSON& inst = instruction.empty() ? *T.it : instruction;
-        std::string inst_name = inst.at("name").get<std::string>();
-
-        std::vector<int> qubits;
-        if (inst.contains("qubits"))
-            qubits = inst.at("qubits").get<std::vector<int>>();
-        auto inst_type = cunqa::constants::INSTRUCTIONS_MAP.at(inst.at("name").get<std::string>());
+        const cunqa::Instruction& inst = instruction ? *instruction : *T.it;
+        const std::string& inst_name = *inst.name;
+        const auto& qubits = inst.qubits;
+        auto inst_type = inst.type;
 
         switch (inst_type)
         {
         case cunqa::constants::MEASURE:
         {
             uint_t measurement = state->apply_measure({qubits[0] + T.zero_qubit});
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& clbits = inst.clbits;
             G.creg[clbits[0] + T.zero_clbit] = (measurement == 1);
             break;
         }
         case cunqa::constants::COPY:
         {
-            auto l_clbits = inst.at("l_clbits").get<std::vector<int>>();
-            auto r_clbits = inst.at("r_clbits").get<std::vector<int>>();
-
-            if(l_clbits.size() != r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < l_clbits.size(); ++i)
-                G.creg[l_clbits[i] + T.zero_clbit] = G.creg[r_clbits[i] + T.zero_clbit];
+            // l_clbits followed by as many r_clbits
+            const auto& clbits = inst.clbits;
+            std::size_t n_copied = clbits.size() / 2;
+            for (size_t i = 0; i < n_copied; ++i)
+                G.creg[clbits[i] + T.zero_clbit] = G.creg[clbits[n_copied + i] + T.zero_clbit];
                 
             break;
         }
@@ -153,25 +175,25 @@ std::string execute_shot_(
             break;
         case cunqa::constants::RX:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             state->apply_mcrx({qubits[0] + T.zero_qubit}, params[0]);
             break;
         }
         case cunqa::constants::RY:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             state->apply_mcry({qubits[0] + T.zero_qubit}, params[0]);
             break;
         }
         case cunqa::constants::RZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             state->apply_mcrz({qubits[0] + T.zero_qubit}, params[0]);
             break;
         }
         case cunqa::constants::U3:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             state->apply_u(qubits[0] + T.zero_qubit, params[0], params[1], params[2]);
             break;
         }
@@ -195,28 +217,28 @@ std::string execute_shot_(
         }
         case cunqa::constants::CRX:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             state->apply_mcrx({control, qubits[1] + T.zero_qubit}, params[0]);
             break;
         }
         case cunqa::constants::CRY:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             state->apply_mcry({control, qubits[1] + T.zero_qubit}, params[0]);
             break;
         }
         case cunqa::constants::CRZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             state->apply_mcrz({control, qubits[1] + T.zero_qubit}, params[0]);
             break;
         }
         case cunqa::constants::CU:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             state->apply_cu({control, qubits[1] + T.zero_qubit}, params[0], params[1], params[2], params[3]);
             break;
@@ -264,7 +286,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::MCP:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             reg_t unsigned_qubits;
             for (size_t i = 0; i < qubits.size(); i++) {
                 unsigned_qubits.push_back((qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit);
@@ -274,7 +296,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::MCRX:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             reg_t unsigned_qubits;
             for (size_t i = 0; i < qubits.size(); i++) {
                 unsigned_qubits.push_back((qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit);
@@ -284,7 +306,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::MCRY:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             reg_t unsigned_qubits;
             for (size_t i = 0; i < qubits.size(); i++) {
                 unsigned_qubits.push_back((qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit);
@@ -294,7 +316,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::MCRZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             reg_t unsigned_qubits;
             for (size_t i = 0; i < qubits.size(); i++) {
                 unsigned_qubits.push_back((qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit);
@@ -304,7 +326,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::MCU:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             reg_t unsigned_qubits;
             for (size_t i = 0; i < qubits.size(); i++) {
                 unsigned_qubits.push_back((qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit);
@@ -323,13 +345,13 @@ std::string execute_shot_(
         }
         case cunqa::constants::GLOBALP:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             state->apply_global_phase(params[0]);
             break;
         }
         case cunqa::constants::UNITARY:
         {
-            auto cunqa_matrix = inst.at("matrix").get<std::vector<CunqaAerMatrix>>()[0];
+            auto cunqa_matrix = T.circuit->extra(inst).at("matrix").get<std::vector<CunqaAerMatrix>>()[0];
             AerComplexVector matrix_data;
             cunqa::sim::convert_cunqa_matrix_to_complex_vector(cunqa_matrix, matrix_data);
             size_t dim = cunqa_matrix.size();
@@ -343,7 +365,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::DIAGONAL:
         {
-            auto cunqa_diagonal = inst.at("matrix").get<std::vector<CunqaAerDiagonalMatrix>>()[0];
+            auto cunqa_diagonal = T.circuit->extra(inst).at("matrix").get<std::vector<CunqaAerDiagonalMatrix>>()[0];
             AER::cvector_t aer_diagonal;
             cunqa::sim::convert_cunqadiagonal_to_aerdiagonal(cunqa_diagonal, aer_diagonal);
             reg_t unsigned_qubits;
@@ -360,17 +382,15 @@ std::string execute_shot_(
         }
         case cunqa::constants::SEND:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();   
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;   
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[qpu_id].id
-                };  
+                auto& queue = G.local_cc_queue[T.index * Ts.size() + T.peers[inst.qpu]];
                 for (auto& clbit : clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
+                    queue.push(G.creg[clbit + T.zero_clbit]);
                 }
+                wake(T.peers[inst.qpu]);
             } else {
                 for (const auto& clbit: clbits) {
                     classical_channel->send_measure(G.creg[clbit + T.zero_clbit], qpu_id);
@@ -380,19 +400,16 @@ std::string execute_shot_(
         }
         case cunqa::constants::RECV:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[qpu_id].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
+                auto& queue = G.local_cc_queue[T.peers[inst.qpu] * Ts.size() + T.index];
+                if (!queue.empty()) {
                     state->flush_ops(); // Execute operations to empty the buffer 
                     for (const auto& clbit: clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
+                        G.creg[clbit + T.zero_clbit] = (queue.front() == 1);
+                        queue.pop();
                     }
                     T.blocked = false;
                 } else {
@@ -409,10 +426,10 @@ std::string execute_shot_(
         }
         case cunqa::constants::CIF:
         {
-            const auto& clbits = inst.at("clbits").get<std::vector<int>>();
-            if (G.creg[clbits.at(0) + T.zero_clbit]) {
-                for(const auto& sub_inst: inst.at("instructions")) {
-                    apply_next_instr(T, sub_inst);
+            const auto& clbits = inst.clbits;
+            if (G.creg[clbits[0] + T.zero_clbit]) {
+                for (const auto& sub_inst: T.circuit->block(inst)) {
+                    apply_next_instr(T, &sub_inst);
                 }
             }
             break;
@@ -431,30 +448,30 @@ std::string execute_shot_(
             state->apply_h(qubits[0] + T.zero_qubit);
 
             uint_t result = state->apply_measure({qubits[0] + T.zero_qubit});
-            G.qc_meas[T.id].push(result);
-            G.qc_meas[T.id].push(state->apply_measure({G.n_qubits - 2}));
+            G.qc_meas[T.index].push(result);
+            G.qc_meas[T.index].push(state->apply_measure({G.n_qubits - 2}));
 
             if (result) {
                 state->apply_reset({qubits[0] + T.zero_qubit});
             }
 
             // Unlock QRECV
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             break;
         }
         case cunqa::constants::QRECV:
         {
             // state->flush_ops();
-            if (!G.qc_meas.contains(inst.at("qpus")[0])) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
             // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
-            std::size_t meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            std::size_t meas1 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
+            std::size_t meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             // Apply, conditioned to the measurement, the X and Z gates
             if (meas1) {
@@ -479,14 +496,14 @@ std::string execute_shot_(
 
                 uint_t result = state->apply_measure({G.n_qubits - 2});
 
-                G.qc_meas[T.id].push(result);
+                G.qc_meas[T.index].push(result);
                 T.cat_entangled = true;
                 T.blocked = true;
-                Ts[inst.at("qpus")[0]].blocked = false;
+                wake(T.peers[inst.qpu]);
                 return;
             } else {
-                uint_t meas = G.qc_meas[inst.at("qpus")[0]].top();
-                G.qc_meas[inst.at("qpus")[0]].pop();
+                uint_t meas = G.qc_meas[T.peers[inst.qpu]].top();
+                G.qc_meas[T.peers[inst.qpu]].pop();
 
                 if (meas) {
                     state->apply_z(qubits[0] + T.zero_qubit); 
@@ -499,68 +516,62 @@ std::string execute_shot_(
         case cunqa::constants::RCONTROL:
         {
             // state->flush_ops();
-            if (!G.qc_meas.contains(inst.at("qpus")[0]) || G.qc_meas[inst.at("qpus")[0]].empty()) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
-            uint_t meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            uint_t meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             if (meas2) {
                 state->apply_mcx({G.n_qubits - 1});
             }
 
-            for(const auto& sub_inst: inst.at("instructions")) {
-                apply_next_instr(T, sub_inst);
+            for (const auto& sub_inst: T.circuit->block(inst)) {
+                apply_next_instr(T, &sub_inst);
             }
 
             state->apply_h(G.n_qubits - 1);
 
             uint_t result = state->apply_measure({G.n_qubits - 1});
-            G.qc_meas[T.id].push(result);
+            G.qc_meas[T.index].push(result);
 
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             T.blocked = false;
             break;
         }
         default:
-            std::cerr << "Instruction not suported!\nInstruction that failed: " << inst.dump(4) << "\n";
+            std::cerr << "Instruction not suported!\nInstruction that failed: " << *inst.name << "\n";
         } // End switch
     };
 
-    while (!G.ended)
+    // Tasks still blocked when none can go on are waiting for messages never sent
+    while (!ready.empty())
     {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
+        auto& T = Ts[ready.pop()];
+        while (!T.blocked && !T.finished)
         {
-            if (T.finished)
-                continue;
-            else if(T.blocked) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, {});
+            apply_next_instr(T, nullptr);
+            if (T.blocked)
+                break;
 
-            if (!T.blocked)
-                ++T.it;
-
-            if (T.it != T.end)
-                G.ended = false;
-            else
+            bool woke_up_other = ready.yield();
+            if (++T.it == T.end) {
                 T.finished = true;
+            } else if (woke_up_other) {
+                ready.push(T.index);
+                break;
+            }
         }
-
     } // End one shot
 
-    std::string result_bits(G.n_clbits, '0');
-    for (const auto &[bitIndex, value] : G.creg)
-    {
-        result_bits[G.n_clbits - bitIndex - 1] = value ? '1' : '0';
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            throw std::runtime_error("Task " + T.id + " is blocked waiting for a message that is never sent.");
     }
 
-    return result_bits;
+    return std::move(G.creg);
 }
 
 } // End of anonymous namespace
@@ -568,6 +579,42 @@ std::string execute_shot_(
 namespace cunqa {
 namespace sim {
 
+AerNoiseModelPool::AerNoiseModelPool(const JSON& noise_model) :
+    prototype_{std::make_unique<Noise::NoiseModel>(noise_model)}
+{ }
+
+AerNoiseModelPool::~AerNoiseModelPool() = default;
+
+std::shared_ptr<Noise::NoiseModel> AerNoiseModelPool::borrow()
+{
+    std::unique_ptr<Noise::NoiseModel> noise_model;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!free_.empty()) {
+            noise_model = std::move(free_.back());
+            free_.pop_back();
+        }
+    }
+    if (!noise_model)
+        noise_model = std::make_unique<Noise::NoiseModel>(*prototype_);
+
+    return std::shared_ptr<Noise::NoiseModel>(noise_model.release(), [this](Noise::NoiseModel* released) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.emplace_back(released);
+    });
+}
+
+namespace {
+
+std::shared_ptr<Noise::NoiseModel> get_noise_model(AerNoiseModelPool* noise_models, const Backend* backend)
+{
+    if (noise_models)
+        return noise_models->borrow();
+    return std::make_shared<Noise::NoiseModel>(backend->config.at("noise_model"));
+}
+
+} // End of anonymous namespace
+
 JSON AerSimulatorAdapter::simulate(const Backend* backend)
 {
     LOGGER_DEBUG("Aer usual simulation");
@@ -587,9 +634,9 @@ JSON AerSimulatorAdapter::simulate(const Backend* backend)
             run_config_json["seed_simulator"] = quantum_task.config.at("seed");
         }
         Config aer_config(run_config_json);
-        Noise::NoiseModel noise_model(backend->config.at("noise_model"));
+        auto noise_model = get_noise_model(noise_models, backend);
 
-        Result result = controller_execute<Controller>(circuits, noise_model, aer_config);
+        Result result = controller_execute<Controller>(circuits, *noise_model, aer_config);
 
         JSON result_json = result.to_json();
         convert_standard_results_Aer(result_json, n_clbits);
@@ -604,12 +651,145 @@ JSON AerSimulatorAdapter::simulate(const Backend* backend)
     return {};
 }
 
-AER::AerState get_configured_aer_state(const JSON& config);
-JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
+JSON AerSimulatorAdapter::simulate_batch(const Backend* backend)
+{
+    LOGGER_DEBUG("Aer batch simulation");
+    try {
+        const auto& quantum_task = qc.quantum_tasks[0];
+
+        auto aer_quantum_task = quantum_task_to_AER(quantum_task);
+        int n_clbits = quantum_task.config.at("num_clbits");
+
+        std::vector<std::shared_ptr<Circuit>> circuits;
+        circuits.push_back(std::make_shared<Circuit>(aer_quantum_task.circuit));
+
+        // Parameter table of Aer: for each parameter, its position in the circuit and its 
+        // value in every set
+        const auto& slots = quantum_task.param_slots();
+        const auto& batch = quantum_task.batch;
+        JSON circuit_params = JSON::array();
+        for (std::size_t i = 0; i < slots.size(); ++i) {
+            std::vector<double> values(batch.size());
+            for (std::size_t j = 0; j < batch.size(); ++j)
+                values[j] = batch[j][i];
+            circuit_params.push_back(JSON::array({JSON::array({slots[i].instruction, slots[i].param}), values}));
+        }
+
+        JSON run_config_json(aer_quantum_task.config);
+        if (quantum_task.config.contains("seed")) {
+            run_config_json["seed_simulator"] = quantum_task.config.at("seed");
+        }
+        if (!quantum_task.batch_shots.empty()) {
+            run_config_json["shots"] = quantum_task.batch_shots[0];
+        }
+        run_config_json["parameterizations"] = JSON::array({circuit_params});
+        run_config_json["runtime_parameter_bind_enable"] = true;
+        Config aer_config(run_config_json);
+        auto noise_model = get_noise_model(noise_models, backend);
+
+        Result result = controller_execute<Controller>(circuits, *noise_model, aer_config);
+
+        // One experiment per set, each one returned as the result of a single execution
+        JSON result_json = result.to_json();
+        JSON experiments = std::move(result_json.at("results"));
+        if (experiments.size() != batch.size())
+            throw std::runtime_error("Aer returned " + std::to_string(experiments.size()) + " results for " + 
+                                     std::to_string(batch.size()) + " parameter sets.");
+
+        JSON results = JSON::array();
+        for (auto& experiment : experiments) {
+            JSON set_result = result_json;
+            set_result["results"] = JSON::array({std::move(experiment)});
+            convert_standard_results_Aer(set_result, n_clbits);
+            results.push_back(std::move(set_result));
+        }
+
+        return {{"batch", results}};
+
+    } catch (const std::exception& e) {
+        LOGGER_ERROR("Error executing the batch in the AER simulator.\n\tTry checking the format of the circuit sent and/or of the noise model.");
+        return {{"ERROR", std::string(e.what())}};
+    }
+    return {};
+}
+
+bool AerSimulatorAdapter::has_native_control_flow(const QuantumTask& quantum_task)
+{
+    return has_native_control_flow_AER(quantum_task);
+}
+
+std::vector<JSON> AerSimulatorAdapter::simulate_many(const Backend* backend)
+{
+    LOGGER_DEBUG("Aer simulation of {} tasks", qc.quantum_tasks.size());
+    const auto& quantum_tasks = qc.quantum_tasks;
+    std::vector<JSON> results(quantum_tasks.size());
+
+    // Tasks are grouped by their run configuration, the number of clbits goes in each circuit
+    std::vector<QuantumTask> aer_quantum_tasks;
+    std::map<std::string, std::vector<std::size_t>> groups;
+    for (std::size_t i = 0; i < quantum_tasks.size(); ++i) {
+        aer_quantum_tasks.push_back(quantum_task_to_AER(quantum_tasks[i]));
+        JSON run_config_json = aer_quantum_tasks.back().config;
+        run_config_json.erase("memory_slots");
+        groups[run_config_json.dump()].push_back(i);
+    }
+
+    std::shared_ptr<Noise::NoiseModel> noise_model;
+    for (const auto& [_, group] : groups) {
+        try {
+            if (group.size() == 1) {
+                AerComputationAdapter aer_ca(quantum_tasks[group[0]]);
+                results[group[0]] = AerSimulatorAdapter(aer_ca, noise_models).simulate(backend);
+                continue;
+            }
+
+            if (!noise_model)
+                noise_model = get_noise_model(noise_models, backend);
+
+            std::vector<std::shared_ptr<Circuit>> circuits;
+            for (auto i : group)
+                circuits.push_back(std::make_shared<Circuit>(aer_quantum_tasks[i].circuit));
+
+            JSON run_config_json(aer_quantum_tasks[group[0]].config);
+            run_config_json.erase("memory_slots");
+            // The experiments are small and independent, Aer runs them in parallel unless told otherwise
+            if (!run_config_json.contains("max_parallel_experiments"))
+                run_config_json["max_parallel_experiments"] = 0;
+            Config aer_config(run_config_json);
+
+            Result result = controller_execute<Controller>(circuits, *noise_model, aer_config);
+
+            JSON result_json = result.to_json();
+            JSON experiments = std::move(result_json.at("results"));
+            if (experiments.size() != group.size())
+                throw std::runtime_error("Aer returned " + std::to_string(experiments.size()) + " results for " + 
+                                         std::to_string(group.size()) + " circuits.");
+
+            for (std::size_t j = 0; j < group.size(); ++j) {
+                JSON task_result = result_json;
+                task_result["results"] = JSON::array({std::move(experiments[j])});
+                convert_standard_results_Aer(task_result, quantum_tasks[group[j]].config.at("num_clbits"));
+                results[group[j]] = std::move(task_result);
+            }
+
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("Error executing the circuits in the AER simulator.\n\tTry checking the format of the circuits sent and/or of the noise model.");
+            for (auto i : group)
+                results[i] = {{"ERROR", std::string(e.what())}};
+        }
+    }
+
+    return results;
+}
+
+// `stream` tells apart the seeds of the states run at the same time, so that their shots do 
+// not draw the same measurements
+AER::AerState get_configured_aer_state(const JSON& config, const std::size_t stream = 0);
+JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc, const std::size_t shot_lanes)
 {
     LOGGER_DEBUG("Aer dynamic simulation");
 
-    std::map<std::string, std::size_t> meas_counter;
+    ShotCounts meas_counter;
     
     JSON qt_config = qc.quantum_tasks[0].config;
     auto shots = qt_config.at("shots").get<std::size_t>();
@@ -624,50 +804,86 @@ JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, co
     if (size(qc.quantum_tasks) > 1)
         n_qubits += 2;
     
-    auto start = std::chrono::high_resolution_clock::now();
-#ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
-        #pragma omp parallel
-        {
-            std::map<std::string, std::size_t> local_counter;
+    // Shots exchanging classical messages with other QPUs can not stop half way
+    auto cancelled = [&]() { return !classical_channel && qc.quantum_tasks[0].is_cancelled(); };
 
-            AER::AerState state = get_configured_aer_state(qt_config);
-
-            #pragma omp for
-            for (std::size_t i = 0; i < shots; i++) {
+    auto start = std::chrono::high_resolution_clock::now();
+    // Each message to the other QPUs carries a measurement of every lane
+    if (classical_channel && !allows_qc && shot_lanes > 1 && classical_channel->concurrent()) {
+        auto counts = run_shot_lanes(*classical_channel, shot_lanes, shots, [&](auto& lane, const std::size_t lane_shots) {
+            ShotCounts lane_counter;
+            AER::AerState state = get_configured_aer_state(qt_config, lane.index());
+            for (std::size_t i = 0; i < lane_shots; i++) {
                 reg_t qubit_ids = state.allocate_qubits(n_qubits);
                 state.initialize();
                 /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
                 state.set_target_gpus(target_gpus);
-                local_counter[execute_shot_(&state, qc.quantum_tasks, classical_channel, allows_qc)]++;
+                lane_counter.add(execute_shot_(&state, qc.quantum_tasks, &lane, allows_qc));
                 state.clear();
             }
+            return lane_counter;
+        });
+        std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+        return {{"counts", counts.to_map()}, {"time_taken", duration.count()}};
+    }
+#ifdef OPENMP_IN_QC
+    {
+        // Messages to other QPUs carry their shot, so that shot i here pairs with shot i there
+        // whatever thread runs it
+        std::optional<comm::ShotChannel> shot_channel;
+        if (classical_channel && !allows_qc)
+            shot_channel.emplace(*classical_channel);
+        // Unless the channel can send and receive from several threads at once
+        bool parallel_shots = !shot_channel || classical_channel->concurrent();
+
+        ShotErrors errors;
+        #pragma omp parallel if(parallel_shots) num_threads(shot_threads())
+        {
+            ShotCounts local_counter;
+            std::optional<AER::AerState> state;
+            try {
+                state.emplace(get_configured_aer_state(qt_config, omp_get_thread_num()));
+            } catch (...) {
+                errors.capture();
+            }
+
+            #pragma omp for
+            for (std::size_t i = 0; i < shots; i++) {
+                if (!state || errors.failed() || cancelled())
+                    continue;
+                try {
+                    reg_t qubit_ids = state->allocate_qubits(n_qubits);
+                    state->initialize();
+                    /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
+                    state->set_target_gpus(target_gpus);
+                    if (shot_channel) {
+                        auto shot = shot_channel->shot(i);
+                        local_counter.add(execute_shot_(&*state, qc.quantum_tasks, &shot, allows_qc));
+                    } else {
+                        local_counter.add(execute_shot_(&*state, qc.quantum_tasks, classical_channel, allows_qc));
+                    }
+                    state->clear();
+                } catch (...) {
+                    errors.capture();
+                }
+            }
 
             #pragma omp critical
-            for (auto& [key, val] : local_counter)
-                meas_counter[key] += val;
-        }
-    } else { // As if OPENMP_IN_QC not enabled
-        AER::AerState state = get_configured_aer_state(qt_config);
-        reg_t qubit_ids;
-        for (std::size_t i = 0; i < shots; i++) {
-            qubit_ids = state.allocate_qubits(n_qubits);
-            state.initialize();
-            /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
-            state.set_target_gpus(target_gpus);
-            meas_counter[execute_shot_(&state, qc.quantum_tasks, classical_channel, allows_qc)]++;
-            state.clear();
-        } // End all shots
+            meas_counter.merge(local_counter);
+        }
+        errors.rethrow();
     }
 #else
     AER::AerState state = get_configured_aer_state(qt_config);
     reg_t qubit_ids;
     for (std::size_t i = 0; i < shots; i++) {
+        if (cancelled())
+            break;
         qubit_ids = state.allocate_qubits(n_qubits);
         state.initialize();
         /* WARNING. The "set_target_gpus" method is particular of CUNQA-Aer fork. Comment it if you are using another Aer version. */
         state.set_target_gpus(target_gpus);
-        meas_counter[execute_shot_(&state, qc.quantum_tasks, classical_channel, allows_qc)]++;
+        meas_counter.add(execute_shot_(&state, qc.quantum_tasks, classical_channel, allows_qc));
         state.clear();
     } // End all shots
 #endif
@@ -677,12 +893,12 @@ JSON AerSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, co
 
 
     JSON result_json = {
-        {"counts", meas_counter},
+        {"counts", meas_counter.to_map()},
         {"time_taken", time_taken}};
     return result_json;
 }
 
-AER::AerState get_configured_aer_state(const JSON& config)
+AER::AerState get_configured_aer_state(const JSON& config, const std::size_t stream)
 {
     AER::AerState state;
 
@@ -693,7 +909,7 @@ AER::AerState get_configured_aer_state(const JSON& config)
     state.configure("device", device);
     state.configure("precision", "double");
     if (config.contains("seed")) {
-        state.configure("seed_simulator", std::to_string(config.at("seed").get<int>()));
+        state.configure("seed_simulator", std::to_string(config.at("seed").get<long long>() + static_cast<long long>(stream)));
     }
 
     return state;
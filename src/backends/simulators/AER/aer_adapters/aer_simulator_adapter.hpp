@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "quantum_task.hpp"
@@ -9,19 +11,54 @@
 
 #include "utils/json.hpp"
 
+namespace AER {
+namespace Noise {
+class NoiseModel;
+} // End of Noise namespace
+} // End of AER namespace
+
 namespace cunqa {
 namespace sim {
 
+// Noise model of a backend, parsed once from its JSON. Aer prepares the model for the method
+// of every execution, so each concurrent execution borrows its own copy, which keeps what
+// previous executions derived from it (superoperators, Kraus operators)
+class AerNoiseModelPool
+{
+public:
+    explicit AerNoiseModelPool(const JSON& noise_model);
+    ~AerNoiseModelPool();
+
+    // The copy goes back to the pool when the last pointer to it is released
+    std::shared_ptr<AER::Noise::NoiseModel> borrow();
+
+private:
+    std::unique_ptr<AER::Noise::NoiseModel> prototype_;
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<AER::Noise::NoiseModel>> free_;
+};
+
 class AerSimulatorAdapter
 {
 public:
     AerSimulatorAdapter() = default;
-    AerSimulatorAdapter(AerComputationAdapter& qc) : qc{qc} {}
+    AerSimulatorAdapter(AerComputationAdapter& qc, AerNoiseModelPool* noise_models = nullptr) : 
+        qc{qc}, 
+        noise_models{noise_models} 
+    {}
     
     JSON simulate(const Backend* backend);
-    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
+    // Every set of the batch of the task, bound at runtime by Aer
+    JSON simulate_batch(const Backend* backend);
+    // Every task as an experiment of the same execution, when their configurations allow it
+    std::vector<JSON> simulate_many(const Backend* backend);
+    // Whether a dynamic task can be simulated by simulate(backend), with its control flow 
+    // lowered to Aer conditionals, instead of shot by shot
+    static bool has_native_control_flow(const QuantumTask& quantum_task);
+    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false, const std::size_t shot_lanes = 1);
 
     AerComputationAdapter qc;
+    AerNoiseModelPool* noise_models = nullptr; // If null, the noise model of the backend is parsed
 
 };
 
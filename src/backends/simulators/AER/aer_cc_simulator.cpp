@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdlib>
+
 #include "aer_cc_simulator.hpp"
 #include "aer_adapters/aer_computation_adapter.hpp"
 #include "aer_adapters/aer_simulator_adapter.hpp"
@@ -11,6 +14,8 @@ AerCCSimulator::AerCCSimulator() :
     classical_channel{std::getenv("SLURM_JOB_ID") + "_"s + std::getenv("SLURM_TASK_PID")}
 {
     classical_channel.publish();
+    if (const char* lanes = std::getenv("CUNQA_QPU_SHOT_LANES"))
+        shot_lanes = std::max(1, std::atoi(lanes));
 };
 
 // Distributed AerSimulator
@@ -22,7 +27,7 @@ JSON AerCCSimulator::execute(const CCBackend& backend, const QuantumTask& quantu
     AerComputationAdapter aer_ca(quantum_task);
     AerSimulatorAdapter aer_sa(aer_ca);
     if (quantum_task.is_dynamic) {
-        return aer_sa.simulate(&classical_channel);
+        return aer_sa.simulate(&classical_channel, false, shot_lanes);
     } else {
         return aer_sa.simulate(&backend);
     }
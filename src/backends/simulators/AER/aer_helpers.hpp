@@ -1,11 +1,14 @@
 #pragma once
 
-#include <regex>
 #include <string>
+#include <string_view>
 #include <bitset>
 #include <chrono>
 #include <vector>
+#include <unordered_set>
 
+#include "quantum_task.hpp"
+#include "utils/constants.hpp"
 #include "logger.hpp"
 
 using namespace std::string_literals;
@@ -20,7 +23,7 @@ using CunqaAerRow = std::vector<CunqaAerComplex>;
 using CunqaAerMatrix = std::vector<CunqaAerRow>;
 using AerComplexVector = std::vector<complex_t>;
 
-const std::vector<std::string> AER_CONFIG_KEYS = {
+const std::unordered_set<std::string_view> AER_CONFIG_KEYS = {
     "shots",
     "method",
     "precision",
@@ -96,13 +99,153 @@ const std::vector<std::string> AER_CONFIG_KEYS = {
 namespace cunqa {
 namespace sim {
 
+namespace {
+
+// Aer names "memory" the clbits of the instructions (also in "l_clbits" and "r_clbits") and 
+// "params" the matrix of the unitaries. Only the keys are renamed, values are copied as they are.
+JSON instruction_to_AER(const JSON& instruction)
+{
+    JSON aer_instruction = JSON::object();
+    for (const auto& [key, value] : instruction.items()) {
+        std::string aer_key = key;
+        if (auto pos = aer_key.find("clbits"); pos != std::string::npos)
+            aer_key.replace(pos, 6, "memory");
+        else if (aer_key == "matrix")
+            aer_key = "params";
+
+        if (key == "instructions" && value.is_array()) {
+            JSON& block = aer_instruction[aer_key] = JSON::array();
+            for (const auto& sub_instruction : value)
+                block.push_back(instruction_to_AER(sub_instruction));
+        } else {
+            aer_instruction[aer_key] = value;
+        }
+    }
+    return aer_instruction;
+}
+
+// Hexadecimal mask of a single clbit, as Aer reads the masks and values of a bfunc
+std::string clbit_mask_AER(const std::size_t clbit)
+{
+    static const char digits[] = "1248";
+    return "0x"s + digits[clbit % 4] + std::string(clbit / 4, '0');
+}
+
+// Appends the Aer instructions of an instruction of the circuit. Dynamic circuits are lowered 
+// to Aer conditionals: measurements also write the register Aer conditions on, a "copy" is a 
+// bfunc writing the copied values and a "cif" evaluates its clbit on a scratch register that 
+// conditions every instruction of its block.
+void append_instruction_to_AER(const JSON& instruction, const std::size_t scratch_register, JSON& aer_instructions)
+{
+    const auto& name = instruction.at("name").get_ref<const std::string&>();
+    if (name == "measure") {
+        auto aer_instruction = instruction_to_AER(instruction);
+        aer_instruction["register"] = aer_instruction.at("memory");
+        aer_instructions.push_back(std::move(aer_instruction));
+    } else if (name == "copy") {
+        const auto& l_clbits = instruction.at("l_clbits");
+        const auto& r_clbits = instruction.at("r_clbits");
+        for (std::size_t i = 0; i < l_clbits.size(); ++i) {
+            auto mask = clbit_mask_AER(r_clbits[i].get<std::size_t>());
+            aer_instructions.push_back({{"name", "bfunc"}, {"mask", mask}, {"relation", "=="}, {"val", mask}, 
+                                        {"register", l_clbits[i]}, {"memory", l_clbits[i]}});
+        }
+    } else if (name == "cif") {
+        auto mask = clbit_mask_AER(instruction.at("clbits")[0].get<std::size_t>());
+        aer_instructions.push_back({{"name", "bfunc"}, {"mask", mask}, {"relation", "=="}, {"val", mask}, 
+                                    {"register", scratch_register}});
+        for (const auto& sub_instruction : instruction.at("instructions")) {
+            auto aer_instruction = instruction_to_AER(sub_instruction);
+            aer_instruction["conditional"] = scratch_register;
+            aer_instructions.push_back(std::move(aer_instruction));
+        }
+    } else {
+        aer_instructions.push_back(instruction_to_AER(instruction));
+    }
+}
+
+// Instructions translated for the last task each thread executed. A parameter update only 
+// changes the values at the parameter slots of the task, so the rest is not translated again.
+const JSON& instructions_to_AER(const QuantumTask& quantum_task)
+{
+    thread_local std::uint64_t cached_version = 0;
+    thread_local JSON cached_instructions;
+    // Where each instruction of the circuit starts among the translated ones
+    thread_local std::vector<std::size_t> positions;
+
+    if (quantum_task.circuit_version() == 0 || quantum_task.circuit_version() != cached_version) {
+        const std::size_t scratch_register = quantum_task.config.at("num_clbits").get<std::size_t>();
+        cached_instructions = JSON::array();
+        positions.clear();
+        for (const auto& instruction : quantum_task.circuit) {
+            positions.push_back(cached_instructions.size());
+            append_instruction_to_AER(instruction, scratch_register, cached_instructions);
+        }
+        cached_version = quantum_task.circuit_version();
+    } else {
+        for (const auto& slot : quantum_task.param_slots())
+            cached_instructions[positions[slot.instruction]]["params"][slot.param] = quantum_task.circuit[slot.instruction]["params"][slot.param];
+    }
+    return cached_instructions;
+}
+
+} // End namespace
+
+// Whether the control flow of a dynamic task can be lowered to Aer conditionals, so that it
+// runs as a single Aer execution. Communications between QPUs need the per shot interpreter, 
+// as do blocks of a "cif" with instructions Aer can not condition.
+bool has_native_control_flow_AER(const QuantumTask& quantum_task)
+{
+    if (!quantum_task.sending_to.empty())
+        return false;
+
+    auto is_remote = [](const Instruction& instruction) {
+        switch (instruction.type) {
+            case constants::SEND:
+            case constants::RECV:
+            case constants::QSEND:
+            case constants::QRECV:
+            case constants::EXPOSE:
+            case constants::RCONTROL:
+                return true;
+            default:
+                return std::find(instruction.qubits.begin(), instruction.qubits.end(), -1) != instruction.qubits.end();
+        }
+    };
+
+    try {
+        const auto& compiled = quantum_task.compiled();
+        for (const auto& instruction : compiled) {
+            if (is_remote(instruction))
+                return false;
+            if (instruction.type != constants::CIF)
+                continue;
+            for (const auto& sub_instruction : compiled.block(instruction)) {
+                switch (sub_instruction.type) {
+                    case constants::MEASURE:
+                    case constants::RESET:
+                    case constants::COPY:
+                    case constants::CIF:
+                        return false;
+                    default:
+                        if (is_remote(sub_instruction))
+                            return false;
+                }
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
 QuantumTask quantum_task_to_AER(const QuantumTask& quantum_task)
 {
     JSON new_config;
     // Generic Aer configuration options
     for (auto& [key, value] : quantum_task.config.items()) {
-        if (std::find(AER_CONFIG_KEYS.begin(), AER_CONFIG_KEYS.end(), key) != AER_CONFIG_KEYS.end()) {
-            new_config[std::string(key)] = value;
+        if (AER_CONFIG_KEYS.contains(key)) {
+            new_config[key] = value;
         }
     }
 
@@ -136,12 +279,10 @@ QuantumTask quantum_task_to_AER(const QuantumTask& quantum_task)
     //JSON Object because if not it generates an array
     JSON new_circuit = {
         {"config", new_config},
-        {"instructions", JSON::parse(std::regex_replace(
-                        std::regex_replace(quantum_task.circuit.dump(), std::regex("clbits"), "memory"),
-                        std::regex("matrix"), "params"))}
+        {"instructions", instructions_to_AER(quantum_task)}
     };
 
-    return QuantumTask(new_circuit, new_config);
+    return QuantumTask(std::move(new_circuit), std::move(new_config));
 }
 
 
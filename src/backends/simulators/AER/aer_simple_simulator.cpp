@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <functional>
+
 #include "aer_simple_simulator.hpp"
 #include "aer_adapters/aer_computation_adapter.hpp"
 #include "aer_adapters/aer_simulator_adapter.hpp"
@@ -5,16 +8,57 @@
 namespace cunqa {
 namespace sim {
 
+AerSimpleSimulator::AerSimpleSimulator() = default;
+AerSimpleSimulator::~AerSimpleSimulator() = default;
+
+void AerSimpleSimulator::prepare(const SimpleBackend& backend)
+{
+    try {
+        noise_models_ = std::make_unique<AerNoiseModelPool>(backend.config.at("noise_model"));
+    } catch (const std::exception& e) {
+        // Every execution parses it again and reports the error to its client
+        LOGGER_ERROR("Error parsing the noise model of the backend: {}", e.what());
+    }
+}
+
 JSON AerSimpleSimulator::execute(const SimpleBackend& backend, const QuantumTask& quantum_task) 
 {
     AerComputationAdapter aer_ca(quantum_task);
-    AerSimulatorAdapter aer_sa(aer_ca);
+    AerSimulatorAdapter aer_sa(aer_ca, noise_models_.get());
 
-    if (quantum_task.is_dynamic) 
+    // Only circuits exchanging data with other QPUs need the shot by shot simulation
+    if (quantum_task.is_dynamic && !AerSimulatorAdapter::has_native_control_flow(quantum_task)) 
         return aer_sa.simulate();
     else
         return aer_sa.simulate(&backend);
 }
 
+std::optional<JSON> AerSimpleSimulator::execute_batch(const SimpleBackend& backend, const QuantumTask& quantum_task) 
+{
+    // Aer binds the sets at runtime on a single circuit, as long as they share the shots
+    const auto& shots = quantum_task.batch_shots;
+    if (quantum_task.is_dynamic || quantum_task.param_slots().empty() || 
+        std::adjacent_find(shots.begin(), shots.end(), std::not_equal_to<>()) != shots.end())
+        return std::nullopt;
+
+    AerComputationAdapter aer_ca(quantum_task);
+    AerSimulatorAdapter aer_sa(aer_ca, noise_models_.get());
+    return aer_sa.simulate_batch(&backend);
+}
+
+std::optional<std::vector<JSON>> AerSimpleSimulator::execute_many(const SimpleBackend& backend, const std::vector<QuantumTask>& quantum_tasks) 
+{
+    // Aer shifts the seed of every circuit of an execution, so seeded tasks would not 
+    // reproduce the results they get on their own
+    for (const auto& quantum_task : quantum_tasks) {
+        if (quantum_task.is_dynamic || !quantum_task.batch.empty() || quantum_task.config.contains("seed"))
+            return std::nullopt;
+    }
+
+    AerComputationAdapter aer_ca(quantum_tasks);
+    AerSimulatorAdapter aer_sa(aer_ca, noise_models_.get());
+    return aer_sa.simulate_many(&backend);
+}
+
 } // End namespace sim
 } // End namespace cunqa
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+
 #include "quantum_task.hpp"
 #include "backends/simple_backend.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
@@ -10,13 +12,22 @@
 namespace cunqa {
 namespace sim {
 
+class AerNoiseModelPool;
+
 class AerSimpleSimulator final : public SimulatorStrategy<SimpleBackend> {
 public:
-    AerSimpleSimulator() = default;
-    ~AerSimpleSimulator() = default;
+    AerSimpleSimulator();
+    ~AerSimpleSimulator();
 
     inline std::string get_name() const override {return "Aer";} 
+    void prepare(const SimpleBackend& backend) override;
     JSON execute(const SimpleBackend& backend, const QuantumTask& circuit) override;
+    std::optional<JSON> execute_batch(const SimpleBackend& backend, const QuantumTask& quantum_task) override;
+    std::optional<std::vector<JSON>> execute_many(const SimpleBackend& backend, const std::vector<QuantumTask>& quantum_tasks) override;
+
+private:
+    // Parsing the noise model can take longer than simulating a small circuit
+    std::unique_ptr<AerNoiseModelPool> noise_models_;
 };
 
 } // End of sim namespace
@@ -1,12 +1,21 @@
+#include <algorithm>
 #include <string>
 #include <unordered_map>
 #include <stack>
 #include <queue>
+#include <optional>
+#include <stdexcept>
 #include <chrono>
 #include <functional>
 #include <cstdlib>
 
 #include "cunqa_simulator_adapter.hpp"
+#include "backends/simulators/ready_queue.hpp"
+#include "backends/simulators/shot_lanes.hpp"
+#include "backends/simulators/shot_counts.hpp"
+#include "backends/simulators/shot_errors.hpp"
+#include "backends/simulators/shot_threads.hpp"
+#include "classical_channel/shot_channel.hpp"
 
 #include "result_cunqasim.hpp"
 #include "executor.hpp"
@@ -18,26 +27,13 @@
 
 namespace {
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
 struct TaskState {
     std::string id;
-    cunqa::JSON::const_iterator it, end;
+    std::size_t index = 0;
+    std::vector<std::size_t> peers; // Task of each QPU the circuit refers to, in the order of the circuit
+    const cunqa::CompiledCircuit* circuit = nullptr;
+    const cunqa::Instruction* it = nullptr;
+    const cunqa::Instruction* end = nullptr;
     int zero_qubit = 0;
     int zero_clbit = 0;
     bool finished = false;
@@ -48,22 +44,23 @@ struct TaskState {
 
 struct GlobalState {
     int n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::stack<int>> qc_meas;
-    std::unordered_map<LocalCCIDs, std::queue<int>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
+    cunqa::sim::ClassicalRegister creg;
+    std::vector<std::stack<int>> qc_meas; // By task
+    std::vector<std::queue<int>> local_cc_queue; // By sender * n_tasks + receiver, to mimic classical communications when executing with quantum communications
     cunqa::comm::ClassicalChannel* chan = nullptr;
 };
 
 
-std::string execute_shot_(
+// `classical_channel` is a comm::ClassicalChannel or a lane of a comm::LaneChannel
+template <typename Channel>
+cunqa::sim::ClassicalRegister execute_shot_(
     Executor& executor, 
     const std::vector<cunqa::QuantumTask>& quantum_tasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
+    Channel* classical_channel,
     const bool allows_qc
 )
 {
-    std::unordered_map<std::string, TaskState> Ts;
+    std::vector<TaskState> Ts;
     GlobalState G;
 
     for (auto &quantum_task : quantum_tasks)
@@ -72,11 +69,13 @@ std::string execute_shot_(
         T.id = quantum_task.id;
         T.zero_qubit = G.n_qubits;
         T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.circuit.begin();
-        T.end = quantum_task.circuit.end();
+        T.circuit = &quantum_task.compiled();
+        T.it = T.circuit->begin();
+        T.end = T.circuit->end();
         T.blocked = false;
         T.finished = false;
-        Ts[quantum_task.id] = T;
+        T.index = Ts.size();
+        Ts.push_back(T);
         
         G.n_qubits += quantum_task.config.at("num_qubits").get<int>();
         G.n_clbits += quantum_task.config.at("num_clbits").get<int>();
@@ -86,6 +85,31 @@ std::string execute_shot_(
     if (size(quantum_tasks) > 1)
         G.n_qubits += 2;
 
+    G.creg = cunqa::sim::ClassicalRegister(G.n_clbits);
+
+    // The QPUs named by the communications, resolved once to their tasks. QPUs outside the 
+    // job are only reached through the classical channel.
+    for (auto& T : Ts) {
+        for (const auto& qpu : T.circuit->qpus()) {
+            auto peer = std::find_if(Ts.begin(), Ts.end(), [&](const TaskState& other) { return other.id == qpu; });
+            T.peers.push_back(peer != Ts.end() ? peer->index : T.index);
+        }
+    }
+    G.qc_meas.resize(Ts.size());
+    G.local_cc_queue.resize(Ts.size() * Ts.size());
+
+    cunqa::sim::ReadyQueue ready;
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            ready.push(T.index);
+    }
+    auto wake = [&](const std::size_t task) {
+        if (Ts[task].blocked) {
+            Ts[task].blocked = false;
+            ready.wake(task);
+        }
+    };
+
     auto generate_entanglement_ = [&]() {
         int meas1 = executor.apply_measure({G.n_qubits - 1});
         if (meas1) {
@@ -99,37 +123,30 @@ std::string execute_shot_(
         executor.apply_gate("cx", {G.n_qubits - 2, G.n_qubits - 1});
     };
 
-    std::function<void(TaskState&, const cunqa::JSON&)> apply_next_instr = 
-        [&](TaskState& T, const cunqa::JSON& instruction = {}) 
+    std::function<void(TaskState&, const cunqa::Instruction*)> apply_next_instr = 
+        [&](TaskState& T, const cunqa::Instruction* instruction = nullptr) 
     {
-        const cunqa::JSON& inst = instruction.empty() ? *T.it : instruction;
-
-        std::vector<int> qubits;
-        if (inst.contains("qubits"))
-            qubits = inst.at("qubits").get<std::vector<int>>();
-        auto inst_type = cunqa::constants::INSTRUCTIONS_MAP.at(inst.at("name").get<std::string>());
-        std::string inst_name = inst.at("name").get<std::string>();
+        const cunqa::Instruction& inst = instruction ? *instruction : *T.it;
+        const auto& qubits = inst.qubits;
+        auto inst_type = inst.type;
+        const std::string& inst_name = *inst.name;
 
         switch (inst_type)
         {
         case cunqa::constants::MEASURE:
         {
             int measurement = executor.apply_measure({qubits[0] + T.zero_qubit});
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& clbits = inst.clbits;
             G.creg[clbits[0] + T.zero_clbit] = (measurement == 1);
             break;
         }
         case cunqa::constants::COPY:
         {
-            auto l_clbits = inst.at("l_clbits").get<std::vector<int>>();
-            auto r_clbits = inst.at("r_clbits").get<std::vector<int>>();
-
-            if(l_clbits.size() != r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < l_clbits.size(); ++i)
-                G.creg[l_clbits[i] + T.zero_clbit] = G.creg[r_clbits[i] + T.zero_clbit];
+            // l_clbits followed by as many r_clbits
+            const auto& clbits = inst.clbits;
+            std::size_t n_copied = clbits.size() / 2;
+            for (size_t i = 0; i < n_copied; ++i)
+                G.creg[clbits[i] + T.zero_clbit] = G.creg[clbits[n_copied + i] + T.zero_clbit];
                 
             break;
         }
@@ -156,17 +173,17 @@ std::string execute_shot_(
         case cunqa::constants::RY:
         case cunqa::constants::RZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
-            executor.apply_parametric_gate(inst_name, {qubits[0] + T.zero_qubit}, params);
+            auto params = T.circuit->params(inst);
+            executor.apply_parametric_gate(inst_name, {qubits[0] + T.zero_qubit}, std::vector<double>(params.begin(), params.end()));
             break;
         }
         case cunqa::constants::CRX:
         case cunqa::constants::CRY:
         case cunqa::constants::CRZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             int control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
-            executor.apply_parametric_gate(inst_name, {control, qubits[1] + T.zero_qubit}, params);
+            executor.apply_parametric_gate(inst_name, {control, qubits[1] + T.zero_qubit}, std::vector<double>(params.begin(), params.end()));
             break;
         }
         case cunqa::constants::SWAP:
@@ -176,17 +193,15 @@ std::string execute_shot_(
         }
         case cunqa::constants::SEND:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();  
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;  
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[qpu_id].id
-                };  
+                auto& queue = G.local_cc_queue[T.index * Ts.size() + T.peers[inst.qpu]];
                 for (auto& clbit : clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
+                    queue.push(G.creg[clbit + T.zero_clbit]);
                 }
+                wake(T.peers[inst.qpu]);
             } else {
                 for (const auto& clbit: clbits) {
                     classical_channel->send_measure(G.creg[clbit + T.zero_clbit], qpu_id);
@@ -196,18 +211,15 @@ std::string execute_shot_(
         }
         case cunqa::constants::RECV:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[qpu_id].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
+                auto& queue = G.local_cc_queue[T.peers[inst.qpu] * Ts.size() + T.index];
+                if (!queue.empty()) {
                     for (const auto& clbit: clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
+                        G.creg[clbit + T.zero_clbit] = (queue.front() == 1);
+                        queue.pop();
                     }
                     T.blocked = false;
                 } else {
@@ -223,10 +235,10 @@ std::string execute_shot_(
         }
         case cunqa::constants::CIF:
         {
-            const auto& clbits = inst.at("clbits").get<std::vector<int>>();
-            if (G.creg[clbits.at(0) + T.zero_clbit]) {
-                for(const auto& sub_inst: inst.at("instructions")) {
-                    apply_next_instr(T, sub_inst);
+            const auto& clbits = inst.clbits;
+            if (G.creg[clbits[0] + T.zero_clbit]) {
+                for (const auto& sub_inst: T.circuit->block(inst)) {
+                    apply_next_instr(T, &sub_inst);
                 }
             }
             break;
@@ -245,29 +257,29 @@ std::string execute_shot_(
 
             int result = executor.apply_measure({qubits[0] + T.zero_qubit});
 
-            G.qc_meas[T.id].push(result);
-            G.qc_meas[T.id].push(executor.apply_measure({G.n_qubits - 2}));
+            G.qc_meas[T.index].push(result);
+            G.qc_meas[T.index].push(executor.apply_measure({G.n_qubits - 2}));
 
             if (result) {
                 executor.apply_gate("x", {qubits[0] + T.zero_qubit});
             }
 
             // Unlock QRECV
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             break;
         }
         case cunqa::constants::QRECV:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0])) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
             // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
-            std::size_t meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            std::size_t meas1 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
+            std::size_t meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             // Apply, conditioned to the measurement, the X and Z gates
             if (meas1) {
@@ -291,14 +303,14 @@ std::string execute_shot_(
 
                 int result = executor.apply_measure({G.n_qubits - 2});
 
-                G.qc_meas[T.id].push(result);
+                G.qc_meas[T.index].push(result);
                 T.cat_entangled = true;
                 T.blocked = true;
-                Ts[inst.at("qpus")[0]].blocked = false;
+                wake(T.peers[inst.qpu]);
                 return;
             } else {
-                int meas = G.qc_meas[inst.at("qpus")[0]].top();
-                G.qc_meas[inst.at("qpus")[0]].pop();
+                int meas = G.qc_meas[T.peers[inst.qpu]].top();
+                G.qc_meas[T.peers[inst.qpu]].pop();
 
                 if (meas) {
                     executor.apply_gate("z", {qubits[0] + T.zero_qubit}); 
@@ -310,68 +322,62 @@ std::string execute_shot_(
         }
         case cunqa::constants::RCONTROL:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0]) || G.qc_meas[inst.at("qpus")[0]].empty()) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
-            int meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            int meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             if (meas2) {
                 executor.apply_gate("x", {G.n_qubits - 1});
             }
 
-            for(const auto& sub_inst: inst.at("instructions")) {
-                apply_next_instr(T, sub_inst);
+            for (const auto& sub_inst: T.circuit->block(inst)) {
+                apply_next_instr(T, &sub_inst);
             }
 
             executor.apply_gate("h", {G.n_qubits - 1});
 
             int result = executor.apply_measure({G.n_qubits - 1});
-            G.qc_meas[T.id].push(result);
+            G.qc_meas[T.index].push(result);
 
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             T.blocked = false;
             break;
         }
         default:
-            std::cerr << "Instruction not suported!" << "\n" << "Instruction that failed: " << inst.dump(4) << "\n";
+            std::cerr << "Instruction not suported!" << "\n" << "Instruction that failed: " << *inst.name << "\n";
         } // End switch
     };
 
-    while (!G.ended)
+    // Tasks still blocked when none can go on are waiting for messages never sent
+    while (!ready.empty())
     {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
+        auto& T = Ts[ready.pop()];
+        while (!T.blocked && !T.finished)
         {
-            if (T.finished)
-                continue;
-            else if(T.blocked) {
-                G.ended = false;
-                continue;
-            }
+            apply_next_instr(T, nullptr);
+            if (T.blocked)
+                break;
 
-            apply_next_instr(T, {});
-
-            if (!T.blocked)
-                ++T.it;
-
-            if (T.it != T.end)
-                G.ended = false;
-            else
+            bool woke_up_other = ready.yield();
+            if (++T.it == T.end) {
                 T.finished = true;
+            } else if (woke_up_other) {
+                ready.push(T.index);
+                break;
+            }
         }
-
     } // End one shot
 
-    std::string result_bits(G.n_clbits, '0');
-    for (const auto &[bitIndex, value] : G.creg)
-    {
-        result_bits[G.n_clbits - bitIndex - 1] = value ? '1' : '0';
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            throw std::runtime_error("Task " + T.id + " is blocked waiting for a message that is never sent.");
     }
 
-    return result_bits;
+    return std::move(G.creg);
 }
 
 } // End of anonymous namespace
@@ -402,10 +408,10 @@ JSON CunqaSimulatorAdapter::simulate([[maybe_unused]] const Backend* backend)
 
 }
 
-JSON CunqaSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
+JSON CunqaSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc, const std::size_t shot_lanes)
 {
     LOGGER_DEBUG("Cunqa dynamic simulation");
-    std::map<std::string, std::size_t> meas_counter;
+    ShotCounts meas_counter;
 
     auto shots = qc.quantum_tasks[0].config.at("shots").get<int>();
     std::string method = qc.quantum_tasks[0].config.at("method").get<std::string>();
@@ -419,39 +425,69 @@ JSON CunqaSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
         n_qubits += 2;
 
 
+    // Shots exchanging classical messages with other QPUs can not stop half way
+    auto cancelled = [&]() { return !classical_channel && qc.quantum_tasks[0].is_cancelled(); };
+
     auto start = std::chrono::high_resolution_clock::now();
+    // Each message to the other QPUs carries a measurement of every lane
+    if (classical_channel && !allows_qc && shot_lanes > 1 && classical_channel->concurrent()) {
+        auto counts = run_shot_lanes(*classical_channel, shot_lanes, shots, [&](auto& lane, const std::size_t lane_shots) {
+            ShotCounts lane_counter;
+            Executor executor(n_qubits);
+            for (std::size_t i = 0; i < lane_shots; i++) {
+                lane_counter.add(execute_shot_(executor, qc.quantum_tasks, &lane, allows_qc));
+                executor.restart_statevector();
+            }
+            return lane_counter;
+        });
+        std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+        return {{"counts", counts.to_map()}, {"time_taken", duration.count()}};
+    }
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
-        #pragma omp parallel
+    {
+        // Messages to other QPUs carry their shot, so that shot i here pairs with shot i there
+        // whatever thread runs it
+        std::optional<comm::ShotChannel> shot_channel;
+        if (classical_channel && !allows_qc)
+            shot_channel.emplace(*classical_channel);
+        // Unless the channel can send and receive from several threads at once
+        bool parallel_shots = !shot_channel || classical_channel->concurrent();
+
+        ShotErrors errors;
+        #pragma omp parallel if(parallel_shots) num_threads(shot_threads())
         {
-            std::map<std::string, std::size_t> local_counter;
-            
+            ShotCounts local_counter;
             Executor executor(n_qubits);
 
             #pragma omp for
             for (std::size_t i = 0; i < shots; i++) {
-                local_counter[execute_shot_(executor, qc.quantum_tasks, classical_channel, allows_qc)]++;
-                executor.restart_statevector();
+                if (errors.failed() || cancelled())
+                    continue;
+                try {
+                    if (shot_channel) {
+                        auto shot = shot_channel->shot(i);
+                        local_counter.add(execute_shot_(executor, qc.quantum_tasks, &shot, allows_qc));
+                    } else {
+                        local_counter.add(execute_shot_(executor, qc.quantum_tasks, classical_channel, allows_qc));
+                    }
+                    executor.restart_statevector();
+                } catch (...) {
+                    errors.capture();
+                }
             }
 
             #pragma omp critical
-            for (auto& [key, val] : local_counter)
-                meas_counter[key] += val;
+            meas_counter.merge(local_counter);
         }
-    } else { // As if OPENMP_IN_QC not enabled
-        Executor executor(n_qubits);
-        for (int i = 0; i < shots; i++)
-        {
-            meas_counter[execute_shot_(executor, qc.quantum_tasks, classical_channel, allows_qc)]++;
-            executor.restart_statevector();
-            
-        } // End all shots
+        errors.rethrow();
     }
 #else
     Executor executor(n_qubits);
     for (int i = 0; i < shots; i++)
     {
-        meas_counter[execute_shot_(executor, qc.quantum_tasks, classical_channel, allows_qc)]++;
+        if (cancelled())
+            break;
+        meas_counter.add(execute_shot_(executor, qc.quantum_tasks, classical_channel, allows_qc));
         executor.restart_statevector();
         
     } // End all shots
@@ -461,7 +497,7 @@ JSON CunqaSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
     float time_taken = duration.count();
 
     JSON result_json = {
-        {"counts", meas_counter},
+        {"counts", meas_counter.to_map()},
         {"time_taken", time_taken}};
     return result_json;
 }
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdlib>
+
 #include "cunqa_cc_simulator.hpp"
 #include "cunqa_adapters/cunqa_computation_adapter.hpp"
 #include "cunqa_adapters/cunqa_simulator_adapter.hpp"
@@ -11,6 +14,8 @@ CunqaCCSimulator::CunqaCCSimulator() :
     classical_channel{std::getenv("SLURM_JOB_ID") + "_"s + std::getenv("SLURM_TASK_PID")}
 {
     classical_channel.publish();
+    if (const char* lanes = std::getenv("CUNQA_QPU_SHOT_LANES"))
+        shot_lanes = std::max(1, std::atoi(lanes));
 };
 
 JSON CunqaCCSimulator::execute([[maybe_unused]] const CCBackend& backend, const QuantumTask& quantum_task)
@@ -21,7 +26,7 @@ JSON CunqaCCSimulator::execute([[maybe_unused]] const CCBackend& backend, const
     CunqaComputationAdapter cunqa_ca(quantum_task);
     CunqaSimulatorAdapter cunqa_sa(cunqa_ca);
     if (quantum_task.is_dynamic) {
-        return cunqa_sa.simulate(&classical_channel);
+        return cunqa_sa.simulate(&classical_channel, false, shot_lanes);
     } else {
         return cunqa_sa.simulate(&backend);
     }
@@ -1,7 +1,10 @@
 
+#include <algorithm>
 #include <unordered_map>
 #include <stack>
 #include <queue>
+#include <optional>
+#include <stdexcept>
 #include <chrono>
 #include <functional>
 #include <cstdlib>
@@ -11,6 +14,12 @@
 #include "utils/helpers/json_to_qasm2.hpp"
 
 #include "maestro_simulator_adapter.hpp"
+#include "backends/simulators/ready_queue.hpp"
+#include "backends/simulators/shot_lanes.hpp"
+#include "backends/simulators/shot_counts.hpp"
+#include "backends/simulators/shot_errors.hpp"
+#include "backends/simulators/shot_threads.hpp"
+#include "classical_channel/shot_channel.hpp"
 #include "maestrolib/Interface.h"
 
 #include "logger.hpp"
@@ -20,26 +29,13 @@
 
 namespace {
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
 struct TaskState {
     std::string id;
-    cunqa::JSON::const_iterator it, end;
+    std::size_t index = 0;
+    std::vector<std::size_t> peers; // Task of each QPU the circuit refers to, in the order of the circuit
+    const cunqa::CompiledCircuit* circuit = nullptr;
+    const cunqa::Instruction* it = nullptr;
+    const cunqa::Instruction* end = nullptr;
     unsigned long zero_qubit = 0;
     unsigned long zero_clbit = 0;
     bool finished = false;
@@ -49,21 +45,22 @@ struct TaskState {
 
 struct GlobalState {
     unsigned long n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::stack<int>> qc_meas;
-    std::unordered_map<LocalCCIDs, std::queue<int>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
+    cunqa::sim::ClassicalRegister creg;
+    std::vector<std::stack<int>> qc_meas; // By task
+    std::vector<std::queue<int>> local_cc_queue; // By sender * n_tasks + receiver, to mimic classical communications when executing with quantum communications
 };
 
 
-std::string execute_shot_(
+// `classical_channel` is a comm::ClassicalChannel or a lane of a comm::LaneChannel
+template <typename Channel>
+cunqa::sim::ClassicalRegister execute_shot_(
     void* simulator, 
     const std::vector<cunqa::QuantumTask>& quantum_tasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
+    Channel* classical_channel,
     const bool allows_qc
 )
 {
-    std::unordered_map<std::string, TaskState> Ts;
+    std::vector<TaskState> Ts;
     GlobalState G;
 
     for (auto &quantum_task : quantum_tasks)
@@ -72,11 +69,13 @@ std::string execute_shot_(
         T.id = quantum_task.id;
         T.zero_qubit = G.n_qubits;
         T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.circuit.begin();
-        T.end = quantum_task.circuit.end();
+        T.circuit = &quantum_task.compiled();
+        T.it = T.circuit->begin();
+        T.end = T.circuit->end();
         T.blocked = false;
         T.finished = false;
-        Ts[quantum_task.id] = T;
+        T.index = Ts.size();
+        Ts.push_back(T);
         
         G.n_qubits += quantum_task.config.at("num_qubits").get<int>();
         G.n_clbits += quantum_task.config.at("num_clbits").get<int>();
@@ -86,6 +85,31 @@ std::string execute_shot_(
     if (size(quantum_tasks) > 1)
         G.n_qubits += 2;
 
+    G.creg = cunqa::sim::ClassicalRegister(G.n_clbits);
+
+    // The QPUs named by the communications, resolved once to their tasks. QPUs outside the 
+    // job are only reached through the classical channel.
+    for (auto& T : Ts) {
+        for (const auto& qpu : T.circuit->qpus()) {
+            auto peer = std::find_if(Ts.begin(), Ts.end(), [&](const TaskState& other) { return other.id == qpu; });
+            T.peers.push_back(peer != Ts.end() ? peer->index : T.index);
+        }
+    }
+    G.qc_meas.resize(Ts.size());
+    G.local_cc_queue.resize(Ts.size() * Ts.size());
+
+    cunqa::sim::ReadyQueue ready;
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            ready.push(T.index);
+    }
+    auto wake = [&](const std::size_t task) {
+        if (Ts[task].blocked) {
+            Ts[task].blocked = false;
+            ready.wake(task);
+        }
+    };
+
     auto generate_entanglement_ = [&]() {
         const unsigned long int q[]{ G.n_qubits - 1, G.n_qubits - 2 };
 
@@ -94,17 +118,14 @@ std::string execute_shot_(
         ApplyCX(simulator, G.n_qubits - 2, G.n_qubits - 1);
     };
 
-    std::function<void(TaskState&, const cunqa::JSON&)> apply_next_instr = 
-        [&](TaskState& T, const cunqa::JSON& instruction = {}) 
+    std::function<void(TaskState&, const cunqa::Instruction*)> apply_next_instr = 
+        [&](TaskState& T, const cunqa::Instruction* instruction = nullptr) 
     {
 
         // This is added to be able to add instructions outside the main loop
-        const cunqa::JSON& inst = instruction.empty() ? *T.it : instruction;
-
-        std::vector<int> qubits;
-        if (inst.contains("qubits"))
-            qubits = inst.at("qubits").get<std::vector<int>>();
-        auto inst_type = cunqa::constants::INSTRUCTIONS_MAP.at(inst.at("name").get<std::string>());
+        const cunqa::Instruction& inst = instruction ? *instruction : *T.it;
+        const auto& qubits = inst.qubits;
+        auto inst_type = inst.type;
 
         switch (inst_type)
         {
@@ -113,21 +134,17 @@ std::string execute_shot_(
             const unsigned long int q[]{ qubits[0] + T.zero_qubit };
             const unsigned long long int measurement = Measure(simulator, q, 1);
 
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& clbits = inst.clbits;
             G.creg[clbits[0] + T.zero_clbit] = (measurement == 1);
             break;
         }
         case cunqa::constants::COPY:
         {
-            auto l_clbits = inst.at("l_clbits").get<std::vector<int>>();
-            auto r_clbits = inst.at("r_clbits").get<std::vector<int>>();
-
-            if(l_clbits.size() != r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < l_clbits.size(); ++i)
-                G.creg[l_clbits[i] + T.zero_clbit] = G.creg[r_clbits[i] + T.zero_clbit];
+            // l_clbits followed by as many r_clbits
+            const auto& clbits = inst.clbits;
+            std::size_t n_copied = clbits.size() / 2;
+            for (size_t i = 0; i < n_copied; ++i)
+                G.creg[clbits[i] + T.zero_clbit] = G.creg[clbits[n_copied + i] + T.zero_clbit];
                 
             break;
         }
@@ -163,31 +180,31 @@ std::string execute_shot_(
             break;
         case cunqa::constants::P:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             ApplyP(simulator, qubits[0] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::RX:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             ApplyRx(simulator, qubits[0] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::RY:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             ApplyRy(simulator, qubits[0] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::RZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             ApplyRz(simulator, qubits[0] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::U:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             ApplyU(simulator, qubits[0] + T.zero_qubit, params[0], params[1], params[2], params[3]);
             break;
         }
@@ -237,38 +254,39 @@ std::string execute_shot_(
             break;
         case cunqa::constants::CP:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             ApplyCP(simulator, control, qubits[1] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::CRX:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             ApplyCRx(simulator, control, qubits[1] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::CRY:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             ApplyCRy(simulator, control, qubits[1] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::CRZ:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             ApplyCRz(simulator, control, qubits[1] + T.zero_qubit, params[0]);
             break;
         }
         case cunqa::constants::CCX:
         {
-            for (int i = 0; i < qubits.size(); i++) {
-                qubits[i] = (qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit;
+            unsigned long ccx_qubits[3];
+            for (int i = 0; i < 3; i++) {
+                ccx_qubits[i] = (qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit;
             }
-            ApplyCCX(simulator, qubits[0], qubits[1], qubits[2]);
+            ApplyCCX(simulator, ccx_qubits[0], ccx_qubits[1], ccx_qubits[2]);
             break;
         }
         case cunqa::constants::CSWAP:
@@ -279,7 +297,7 @@ std::string execute_shot_(
         }
         case cunqa::constants::CU:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             unsigned long control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             ApplyCU(simulator, control, qubits[0] + T.zero_qubit, params[0], params[1], params[2], params[3]);
             break;
@@ -294,17 +312,15 @@ std::string execute_shot_(
         }
         case cunqa::constants::SEND:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();  
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;  
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[qpu_id].id
-                };  
+                auto& queue = G.local_cc_queue[T.index * Ts.size() + T.peers[inst.qpu]];
                 for (auto& clbit : clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
+                    queue.push(G.creg[clbit + T.zero_clbit]);
                 }
+                wake(T.peers[inst.qpu]);
             } else {
                 for (const auto& clbit: clbits) {
                     classical_channel->send_measure(G.creg[clbit + T.zero_clbit], qpu_id);
@@ -314,18 +330,15 @@ std::string execute_shot_(
         }
         case cunqa::constants::RECV:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[qpu_id].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
+                auto& queue = G.local_cc_queue[T.peers[inst.qpu] * Ts.size() + T.index];
+                if (!queue.empty()) {
                     for (const auto& clbit: clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
+                        G.creg[clbit + T.zero_clbit] = (queue.front() == 1);
+                        queue.pop();
                     }
                     T.blocked = false;
                 } else {
@@ -341,10 +354,10 @@ std::string execute_shot_(
         }
         case cunqa::constants::CIF:
         {
-            const auto& clbits = inst.at("clbits").get<std::vector<int>>();
-            if (G.creg[clbits.at(0) + T.zero_clbit]) {
-                for(const auto& sub_inst: inst.at("instructions")) {
-                    apply_next_instr(T, sub_inst);
+            const auto& clbits = inst.clbits;
+            if (G.creg[clbits[0] + T.zero_clbit]) {
+                for (const auto& sub_inst: T.circuit->block(inst)) {
+                    apply_next_instr(T, &sub_inst);
                 }
             }
             break;
@@ -363,11 +376,11 @@ std::string execute_shot_(
 
             const unsigned long int q1[]{ qubits[0] + T.zero_qubit };
             int measurement_as_int = static_cast<int>(Measure(simulator, q1, 1));
-            G.qc_meas[T.id].push(measurement_as_int);
+            G.qc_meas[T.index].push(measurement_as_int);
 
             const unsigned long int q2[]{ G.n_qubits - 2 };
             int aux_meas = static_cast<int>(Measure(simulator, q2, 1));
-            G.qc_meas[T.id].push(aux_meas);
+            G.qc_meas[T.index].push(aux_meas);
 
             if (measurement_as_int) {
                 const unsigned long int q3[]{ qubits[0] + T.zero_qubit };
@@ -375,21 +388,21 @@ std::string execute_shot_(
             }
 
             // Unlock QRECV
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             break;
         }
         case cunqa::constants::QRECV:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0])) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
             // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
-            std::size_t meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            std::size_t meas1 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
+            std::size_t meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             // Apply, conditioned to the measurement, the X and Z gates
             if (meas1) {
@@ -415,14 +428,14 @@ std::string execute_shot_(
                 const unsigned long int q[]{ G.n_qubits - 2 };
                 int measurement_as_int = static_cast<int>(Measure(simulator, q, 1));
 
-                G.qc_meas[T.id].push(measurement_as_int);
+                G.qc_meas[T.index].push(measurement_as_int);
                 T.cat_entangled = true;
                 T.blocked = true;
-                Ts[inst.at("qpus")[0]].blocked = false;
+                wake(T.peers[inst.qpu]);
                 return;
             } else {
-                int meas = G.qc_meas[inst.at("qpus")[0]].top();
-                G.qc_meas[inst.at("qpus")[0]].pop();
+                int meas = G.qc_meas[T.peers[inst.qpu]].top();
+                G.qc_meas[T.peers[inst.qpu]].pop();
 
                 if (meas) {
                     ApplyZ(simulator, qubits[0] + T.zero_qubit);
@@ -434,69 +447,63 @@ std::string execute_shot_(
         }
         case cunqa::constants::RCONTROL:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0]) || G.qc_meas[inst.at("qpus")[0]].empty()) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
-            int meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            int meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             if (meas2) {
                 ApplyX(simulator, G.n_qubits - 1);
             }
 
-            for(const auto& sub_inst: inst.at("instructions")) {
-                apply_next_instr(T, sub_inst);
+            for (const auto& sub_inst: T.circuit->block(inst)) {
+                apply_next_instr(T, &sub_inst);
             }
 
             ApplyH(simulator, G.n_qubits - 1);
 
             const unsigned long int q[]{ G.n_qubits - 1 };
             int measurement_as_int = static_cast<int>(Measure(simulator, q, 1));
-            G.qc_meas[T.id].push(measurement_as_int);
+            G.qc_meas[T.index].push(measurement_as_int);
 
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             T.blocked = false;
             break;
         }
         default:
-            std::cerr << "Instruction not suported!" << "\n" << "Instruction that failed: " << inst.dump(4) << "\n";
+            std::cerr << "Instruction not suported!" << "\n" << "Instruction that failed: " << *inst.name << "\n";
         } // End switch
     };
 
-    while (!G.ended)
+    // Tasks still blocked when none can go on are waiting for messages never sent
+    while (!ready.empty())
     {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
-        {
-            if (T.finished)
-                continue;
-            else if(T.blocked) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, {});
-
-            if (!T.blocked)
-                ++T.it;
+        auto& T = Ts[ready.pop()];
+        while (!T.blocked && !T.finished)
+        {
+            apply_next_instr(T, nullptr);
+            if (T.blocked)
+                break;
 
-            if (T.it != T.end)
-                G.ended = false;
-            else
+            bool woke_up_other = ready.yield();
+            if (++T.it == T.end) {
                 T.finished = true;
+            } else if (woke_up_other) {
+                ready.push(T.index);
+                break;
+            }
         }
-
     } // End one shot
 
-    std::string result_bits(G.n_clbits, '0');
-    for (const auto &[bitIndex, value] : G.creg)
-    {
-        result_bits[G.n_clbits - bitIndex - 1] = value ? '1' : '0';
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            throw std::runtime_error("Task " + T.id + " is blocked waiting for a message that is never sent.");
     }
 
-    return result_bits;
+    return std::move(G.creg);
 }
 
 
@@ -643,10 +650,10 @@ JSON MaestroSimulatorAdapter::simulate(const Backend* backend)
     return {};
 }
 
-JSON MaestroSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
+JSON MaestroSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc, const std::size_t shot_lanes)
 {
     LOGGER_DEBUG("Maestro dynamic simulation");
-    std::map<std::string, std::size_t> meas_counter;
+    ShotCounts meas_counter;
     
     auto shots = qc.quantum_tasks[0].config.at("shots").get<std::size_t>();
 
@@ -718,43 +725,71 @@ JSON MaestroSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel
         simulationType = 0; // statevector
     }
 
+    // Shots exchanging classical messages with other QPUs can not stop half way
+    auto cancelled = [&]() { return !classical_channel && qc.quantum_tasks[0].is_cancelled(); };
+
     auto start = std::chrono::high_resolution_clock::now();
+    // Each message to the other QPUs carries a measurement of every lane
+    if (classical_channel && !allows_qc && shot_lanes > 1 && classical_channel->concurrent()) {
+        auto counts = run_shot_lanes(*classical_channel, shot_lanes, shots, [&](auto& lane, const std::size_t lane_shots) {
+            ShotCounts lane_counter;
+            auto simulatorHandle = CreateSimulator(simulatorType, simulationType);
+            if (simulatorHandle == 0)
+                throw std::runtime_error("Unable to create the Maestro Simulator.");
+            auto simulator = GetSimulator(simulatorHandle);
+            for (std::size_t i = 0; i < lane_shots; i++) {
+                AllocateQubits(simulator, n_qubits);
+                InitializeSimulator(simulator);
+                lane_counter.add(execute_shot_(simulator, qc.quantum_tasks, &lane, allows_qc));
+                ClearSimulator(simulator);
+            }
+            return lane_counter;
+        });
+        std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+        return {{"counts", counts.to_map()}, {"time_taken", duration.count()}};
+    }
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
-        #pragma omp parallel
-        {
-            std::map<std::string, std::size_t> local_counter;
-            
+    {
+        // Messages to other QPUs carry their shot, so that shot i here pairs with shot i there
+        // whatever thread runs it
+        std::optional<comm::ShotChannel> shot_channel;
+        if (classical_channel && !allows_qc)
+            shot_channel.emplace(*classical_channel);
+        // Unless the channel can send and receive from several threads at once
+        bool parallel_shots = !shot_channel || classical_channel->concurrent();
+
+        ShotErrors errors;
+        #pragma omp parallel if(parallel_shots) num_threads(shot_threads())
+        {
+            ShotCounts local_counter;
             auto simulatorHandle = CreateSimulator(simulatorType, simulationType);
-            auto simulator = GetSimulator(simulatorHandle); // Not error handling
+            if (simulatorHandle == 0)
+                errors.capture(std::make_exception_ptr(std::runtime_error("Unable to create the Maestro Simulator.")));
+            auto simulator = simulatorHandle != 0 ? GetSimulator(simulatorHandle) : nullptr;
 
             #pragma omp for
             for (std::size_t i = 0; i < shots; i++) {
-                AllocateQubits(simulator, n_qubits);
-                InitializeSimulator(simulator);
-                local_counter[execute_shot_(simulator, qc.quantum_tasks, classical_channel, allows_qc)]++;
-                ClearSimulator(simulator);
+                if (!simulator || errors.failed() || cancelled())
+                    continue;
+                try {
+                    AllocateQubits(simulator, n_qubits);
+                    InitializeSimulator(simulator);
+                    if (shot_channel) {
+                        auto shot = shot_channel->shot(i);
+                        local_counter.add(execute_shot_(simulator, qc.quantum_tasks, &shot, allows_qc));
+                    } else {
+                        local_counter.add(execute_shot_(simulator, qc.quantum_tasks, classical_channel, allows_qc));
+                    }
+                    ClearSimulator(simulator);
+                } catch (...) {
+                    errors.capture();
+                }
             }
 
             #pragma omp critical
-            for (auto& [key, val] : local_counter)
-                meas_counter[key] += val;
-        }
-    } else { // As if OPENMP_IN_QC not enabled
-        auto simulatorHandle = CreateSimulator(simulatorType, simulationType);
-        if (simulatorHandle == 0) {
-            LOGGER_ERROR("Error creating the Maestro Simulator.");
-            return {{"ERROR", "Unable to create the Maestro Simulator."}};
+            meas_counter.merge(local_counter);
         }
-        auto simulator = GetSimulator(simulatorHandle);
-
-        for (std::size_t i = 0; i < shots; i++)
-        {
-            AllocateQubits(simulator, n_qubits); // From CUNQA: Maybe allocate after shots and restart the state in each shot for better performance?
-            InitializeSimulator(simulator);
-            meas_counter[execute_shot_(simulator, qc.quantum_tasks, classical_channel, allows_qc)]++;
-            ClearSimulator(simulator);
-        } // End all shots
+        errors.rethrow();
     }
 #else
     auto simulatorHandle = CreateSimulator(simulatorType, simulationType);
@@ -766,9 +801,11 @@ JSON MaestroSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel
 
     for (std::size_t i = 0; i < shots; i++)
     {
+        if (cancelled())
+            break;
         AllocateQubits(simulator, n_qubits); // From CUNQA: Maybe allocate after shots and restart the state in each shot for better performance?
         InitializeSimulator(simulator);
-        meas_counter[execute_shot_(simulator, qc.quantum_tasks, classical_channel, allows_qc)]++;
+        meas_counter.add(execute_shot_(simulator, qc.quantum_tasks, classical_channel, allows_qc));
         ClearSimulator(simulator);
     } // End all shots
 #endif
@@ -777,7 +814,7 @@ JSON MaestroSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel
     float time_taken = duration.count();
 
     JSON result_json = {
-        {"counts", meas_counter},
+        {"counts", meas_counter.to_map()},
         {"time_taken", time_taken} };
 
     return result_json;
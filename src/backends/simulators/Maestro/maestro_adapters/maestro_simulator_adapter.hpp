@@ -19,7 +19,7 @@ public:
     MaestroSimulatorAdapter(MaestroComputationAdapter& qc);
 
     JSON simulate(const Backend* backend);
-    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
+    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false, const std::size_t shot_lanes = 1);
 
     MaestroComputationAdapter qc;
 private:
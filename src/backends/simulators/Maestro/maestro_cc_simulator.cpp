@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdlib>
+
 #include "maestro_cc_simulator.hpp"
 #include "maestro_adapters/maestro_computation_adapter.hpp"
 #include "maestro_adapters/maestro_simulator_adapter.hpp"
@@ -11,6 +14,8 @@ MaestroCCSimulator::MaestroCCSimulator() :
     classical_channel{std::getenv("SLURM_JOB_ID") + "_"s + std::getenv("SLURM_TASK_PID")}
 {
     classical_channel.publish();
+    if (const char* lanes = std::getenv("CUNQA_QPU_SHOT_LANES"))
+        shot_lanes = std::max(1, std::atoi(lanes));
 };
 
 // Distributed MaestroSimulator
@@ -22,7 +27,7 @@ JSON MaestroCCSimulator::execute(const CCBackend& backend, const QuantumTask& qu
     MaestroComputationAdapter maestro_ca(quantum_task);
     MaestroSimulatorAdapter maestro_sa(maestro_ca);
     if (quantum_task.is_dynamic) {
-        return maestro_sa.simulate(&classical_channel);
+        return maestro_sa.simulate(&classical_channel, false, shot_lanes);
     } else {
         return maestro_sa.simulate(&backend);
     }
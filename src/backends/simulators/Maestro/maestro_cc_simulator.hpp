@@ -21,6 +21,7 @@ public:
 
 private:
     comm::ClassicalChannel classical_channel;
+    std::size_t shot_lanes = 1; // Shots run at the same time, sharing their messages
 };
 
 
@@ -1,43 +1,38 @@
 
 #include "munich_simulator_adapter.hpp"
 
+#include <algorithm>
 #include <unordered_map>
 #include <stack>
 #include <queue>
 #include <chrono>
 #include <thread>
 #include <functional>
+#include <optional>
+#include <stdexcept>
 
 #include "StochasticNoiseSimulator.hpp"
 
 #include "quantum_task.hpp"
 #include "backends/simulators/simulator_strategy.hpp"
+#include "backends/simulators/ready_queue.hpp"
+#include "backends/simulators/shot_counts.hpp"
+#include "backends/simulators/shot_errors.hpp"
+#include "backends/simulators/shot_threads.hpp"
+#include "classical_channel/shot_channel.hpp"
 #include "logger.hpp"
 
 using namespace qc;
 
 namespace {
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
-
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
-    }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
-
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
-    }
-};
-
 struct TaskState {
     std::string id;
-    cunqa::JSON::const_iterator it, end;
+    std::size_t index = 0;
+    std::vector<std::size_t> peers; // Task of each QPU the circuit refers to, in the order of the circuit
+    const cunqa::CompiledCircuit* circuit = nullptr;
+    const cunqa::Instruction* it = nullptr;
+    const cunqa::Instruction* end = nullptr;
     int zero_qubit = 0;
     int zero_clbit = 0;
     bool finished = false;
@@ -47,10 +42,9 @@ struct TaskState {
 
 struct GlobalState {
     int n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::stack<int>> qc_meas;
-    std::unordered_map<LocalCCIDs, std::queue<int>, LocalIDsHash> local_cc_queue;  // To mimic classical communications when executing with quantum communications
-    bool ended = false;
+    cunqa::sim::ClassicalRegister creg;
+    std::vector<std::stack<int>> qc_meas; // By task
+    std::vector<std::queue<int>> local_cc_queue; // By sender * n_tasks + receiver, to mimic classical communications when executing with quantum communications
 };
 
 } // End of anonymous namespace
@@ -58,13 +52,31 @@ struct GlobalState {
 namespace cunqa {
 namespace sim {
 
-std::string MunichSimulatorAdapter::execute_shot_(
+void MunichSimulatorAdapter::start_shot_(const std::size_t n_qubits)
+{
+    if (!zero_state_) {
+        initializeSimulationAdapter(n_qubits);
+        zero_state_ = rootEdge;
+        dd->incRef(*zero_state_);
+        return;
+    }
+
+    // Between shots only the initial state is alive, so it is the cheapest point to collect
+    dd->decRef(rootEdge);
+    dd->garbageCollect();
+    rootEdge = *zero_state_;
+    dd->incRef(rootEdge);
+}
+
+// `classical_channel` is a comm::ClassicalChannel or a shot of a comm::ShotChannel.
+template <typename Channel>
+ClassicalRegister MunichSimulatorAdapter::execute_shot_(
     const std::vector<QuantumTask> &quantum_tasks, 
-    comm::ClassicalChannel *classical_channel,
+    Channel *classical_channel,
     const bool allows_qc
 )
 {
-    std::unordered_map<std::string, TaskState> Ts;
+    std::vector<TaskState> Ts;
     GlobalState G;
 
     for (auto &quantum_task : quantum_tasks)
@@ -73,11 +85,13 @@ std::string MunichSimulatorAdapter::execute_shot_(
         T.id = quantum_task.id;
         T.zero_qubit = G.n_qubits;
         T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.circuit.begin();
-        T.end = quantum_task.circuit.end();
+        T.circuit = &quantum_task.compiled();
+        T.it = T.circuit->begin();
+        T.end = T.circuit->end();
         T.blocked = false;
         T.finished = false;
-        Ts[quantum_task.id] = T;
+        T.index = Ts.size();
+        Ts.push_back(T);
         
         G.n_qubits += quantum_task.config.at("num_qubits").get<int>();
         G.n_clbits += quantum_task.config.at("num_clbits").get<int>();
@@ -87,6 +101,31 @@ std::string MunichSimulatorAdapter::execute_shot_(
     if (size(quantum_tasks) > 1)
         G.n_qubits += 2;
 
+    G.creg = cunqa::sim::ClassicalRegister(G.n_clbits);
+
+    // The QPUs named by the communications, resolved once to their tasks. QPUs outside the 
+    // job are only reached through the classical channel.
+    for (auto& T : Ts) {
+        for (const auto& qpu : T.circuit->qpus()) {
+            auto peer = std::find_if(Ts.begin(), Ts.end(), [&](const TaskState& other) { return other.id == qpu; });
+            T.peers.push_back(peer != Ts.end() ? peer->index : T.index);
+        }
+    }
+    G.qc_meas.resize(Ts.size());
+    G.local_cc_queue.resize(Ts.size() * Ts.size());
+
+    cunqa::sim::ReadyQueue ready;
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            ready.push(T.index);
+    }
+    auto wake = [&](const std::size_t task) {
+        if (Ts[task].blocked) {
+            Ts[task].blocked = false;
+            ready.wake(task);
+        }
+    };
+
     auto generate_entanglement_ = [&]() {
         int meas1 = measureAdapter(G.n_qubits - 1) - '0';
         int meas2 = measureAdapter(G.n_qubits - 2) - '0';
@@ -105,36 +144,29 @@ std::string MunichSimulatorAdapter::execute_shot_(
         applyOperationToStateAdapter(std::move(std_op2));
     };
 
-    std::function<void(TaskState&, const JSON&)> apply_next_instr = 
-        [&](TaskState& T, const JSON& instruction = {}) 
+    std::function<void(TaskState&, const Instruction*)> apply_next_instr = 
+        [&](TaskState& T, const Instruction* instruction = nullptr) 
     {
-        const JSON& inst = instruction.empty() ? *T.it : instruction;
-        std::string inst_name = inst.at("name").get<std::string>();
-
-        std::vector<int> qubits;
-        if (inst.contains("qubits"))
-            qubits = inst.at("qubits").get<std::vector<int>>();
-        auto inst_type = constants::INSTRUCTIONS_MAP.at(inst.at("name").get<std::string>());
+        const Instruction& inst = instruction ? *instruction : *T.it;
+        const std::string& inst_name = *inst.name;
+        const auto& qubits = inst.qubits;
+        auto inst_type = inst.type;
         
         switch (inst_type) {
         case constants::MEASURE:
         {
             char char_measurement = measureAdapter(qubits[0] + T.zero_qubit);
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& clbits = inst.clbits;
             G.creg[clbits[0] + T.zero_clbit] = (char_measurement == '1');
             break;
         }
         case constants::COPY:
         {
-            auto l_clbits = inst.at("l_clbits").get<std::vector<int>>();
-            auto r_clbits = inst.at("r_clbits").get<std::vector<int>>();
-
-            if(l_clbits.size() != r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < l_clbits.size(); ++i)
-                G.creg[l_clbits[i] + T.zero_clbit] = G.creg[r_clbits[i] + T.zero_clbit];
+            // l_clbits followed by as many r_clbits
+            const auto& clbits = inst.clbits;
+            std::size_t n_copied = clbits.size() / 2;
+            for (size_t i = 0; i < n_copied; ++i)
+                G.creg[clbits[i] + T.zero_clbit] = G.creg[clbits[n_copied + i] + T.zero_clbit];
                 
             break;
         }
@@ -166,8 +198,8 @@ std::string MunichSimulatorAdapter::execute_shot_(
         case constants::U3:
         case constants::U:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
-            auto simple_gate = std::make_unique<StandardOperation>(qubits[0] + T.zero_qubit, MUNICH_INSTRUCTIONS_MAP.at(inst_type), params);
+            auto params = T.circuit->params(inst);
+            auto simple_gate = std::make_unique<StandardOperation>(qubits[0] + T.zero_qubit, MUNICH_INSTRUCTIONS_MAP.at(inst_type), std::vector<fp>(params.begin(), params.end()));
             applyOperationToStateAdapter(std::move(simple_gate));
             break;
         }
@@ -203,9 +235,9 @@ std::string MunichSimulatorAdapter::execute_shot_(
         case constants::XXMYY:
         case constants::XXPYY:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             Targets targets = {static_cast<unsigned int>(qubits[0] + T.zero_qubit), static_cast<unsigned int>(qubits[1] + T.zero_qubit)};
-            auto two_gate = std::make_unique<StandardOperation>(targets, MUNICH_INSTRUCTIONS_MAP.at(inst_type), params);
+            auto two_gate = std::make_unique<StandardOperation>(targets, MUNICH_INSTRUCTIONS_MAP.at(inst_type), std::vector<fp>(params.begin(), params.end()));
             applyOperationToStateAdapter(std::move(two_gate));
             break;
         }
@@ -218,31 +250,33 @@ std::string MunichSimulatorAdapter::execute_shot_(
         case constants::CU3:
         case constants::CU:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
+            auto params = T.circuit->params(inst);
             int ctrl = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
             Control control(ctrl);
-            auto two_gate = std::make_unique<StandardOperation>(control, qubits[1] + T.zero_qubit, MUNICH_INSTRUCTIONS_MAP.at(inst_type), params);
+            auto two_gate = std::make_unique<StandardOperation>(control, qubits[1] + T.zero_qubit, MUNICH_INSTRUCTIONS_MAP.at(inst_type), std::vector<fp>(params.begin(), params.end()));
             applyOperationToStateAdapter(std::move(two_gate));
             break;
         }
         case constants::MCX:
         {
-            for (size_t i = 0; i < qubits.size(); i++) {
-                qubits[i] = (qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit;
+            std::vector<int> mc_qubits(qubits.begin(), qubits.end());
+            for (size_t i = 0; i < mc_qubits.size(); i++) {
+                mc_qubits[i] = (mc_qubits[i] == -1) ? G.n_qubits - 1 : mc_qubits[i] + T.zero_qubit;
             }
-            Controls controls(qubits.begin(), qubits.end() - 1);
-            auto mc_gate = std::make_unique<StandardOperation>(controls, qubits[qubits.size() - 1], MUNICH_INSTRUCTIONS_MAP.at(inst_type));
+            Controls controls(mc_qubits.begin(), mc_qubits.end() - 1);
+            auto mc_gate = std::make_unique<StandardOperation>(controls, mc_qubits.back(), MUNICH_INSTRUCTIONS_MAP.at(inst_type));
             applyOperationToStateAdapter(std::move(mc_gate));
             break;
         }
         case constants::MCP:
         {
-            auto params = inst.at("params").get<std::vector<double>>();
-            for (size_t i = 0; i < qubits.size(); i++) {
-                qubits[i] = (qubits[i] == -1) ? G.n_qubits - 1 : qubits[i] + T.zero_qubit;
+            auto params = T.circuit->params(inst);
+            std::vector<int> mc_qubits(qubits.begin(), qubits.end());
+            for (size_t i = 0; i < mc_qubits.size(); i++) {
+                mc_qubits[i] = (mc_qubits[i] == -1) ? G.n_qubits - 1 : mc_qubits[i] + T.zero_qubit;
             }
-            Controls controls(qubits.begin(), qubits.end() - 1);
-            auto mc_gate = std::make_unique<StandardOperation>(controls, qubits[qubits.size() - 1], MUNICH_INSTRUCTIONS_MAP.at(inst_type), params);
+            Controls controls(mc_qubits.begin(), mc_qubits.end() - 1);
+            auto mc_gate = std::make_unique<StandardOperation>(controls, mc_qubits.back(), MUNICH_INSTRUCTIONS_MAP.at(inst_type), std::vector<fp>(params.begin(), params.end()));
             applyOperationToStateAdapter(std::move(mc_gate));
             break;
         }
@@ -261,17 +295,15 @@ std::string MunichSimulatorAdapter::execute_shot_(
         }
         case constants::SEND:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();   
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;   
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[qpu_id].id
-                }; 
+                auto& queue = G.local_cc_queue[T.index * Ts.size() + T.peers[inst.qpu]];
                 for (auto& clbit : clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
+                    queue.push(G.creg[clbit + T.zero_clbit]);
                 }
+                wake(T.peers[inst.qpu]);
             } else {
                 for (const auto& clbit: clbits) {
                     classical_channel->send_measure(G.creg[clbit + T.zero_clbit], qpu_id);
@@ -281,18 +313,15 @@ std::string MunichSimulatorAdapter::execute_shot_(
         }
         case constants::RECV:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[qpu_id].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
+                auto& queue = G.local_cc_queue[T.peers[inst.qpu] * Ts.size() + T.index];
+                if (!queue.empty()) {
                     for (const auto& clbit: clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
+                        G.creg[clbit + T.zero_clbit] = (queue.front() == 1);
+                        queue.pop();
                     }
                     T.blocked = false;
                 } else {
@@ -309,10 +338,10 @@ std::string MunichSimulatorAdapter::execute_shot_(
         }
         case cunqa::constants::CIF:
         {
-            const auto& clbits = inst.at("clbits").get<std::vector<int>>();
-            if (G.creg[clbits.at(0) + T.zero_clbit]) {
-                for(const auto& sub_inst: inst.at("instructions")) {
-                    apply_next_instr(T, sub_inst);
+            const auto& clbits = inst.clbits;
+            if (G.creg[clbits[0] + T.zero_clbit]) {
+                for (const auto& sub_inst: T.circuit->block(inst)) {
+                    apply_next_instr(T, &sub_inst);
                 }
             }
             break;
@@ -332,8 +361,8 @@ std::string MunichSimulatorAdapter::execute_shot_(
 
             int result = measureAdapter(qubits[0] + T.zero_qubit) - '0';
 
-            G.qc_meas[T.id].push(result);
-            G.qc_meas[T.id].push(measureAdapter(G.n_qubits - 2) - '0');
+            G.qc_meas[T.index].push(result);
+            G.qc_meas[T.index].push(measureAdapter(G.n_qubits - 2) - '0');
 
             // We reset to 0 the qubit sent and the EPR (we cannot use the reset op in DD)
             if (result)
@@ -343,21 +372,21 @@ std::string MunichSimulatorAdapter::execute_shot_(
             }
 
             // Unlock QRECV
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             break;
         }
         case constants::QRECV:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0])) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
             // Receive the measurements from the sender
-            int meas1 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
-            int meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            int meas1 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
+            int meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             // Apply, conditioned to the measurement, the X and Z gates
             if (meas1) {
@@ -388,14 +417,14 @@ std::string MunichSimulatorAdapter::execute_shot_(
 
                 int result = measureAdapter(G.n_qubits - 2) - '0';
 
-                G.qc_meas[T.id].push(result);
+                G.qc_meas[T.index].push(result);
                 T.cat_entangled = true;
                 T.blocked = true;
-                Ts[inst.at("qpus")[0]].blocked = false;
+                wake(T.peers[inst.qpu]);
                 return;
             } else {
-                int meas = G.qc_meas[inst.at("qpus")[0]].top();
-                G.qc_meas[inst.at("qpus")[0]].pop();
+                int meas = G.qc_meas[T.peers[inst.qpu]].top();
+                G.qc_meas[T.peers[inst.qpu]].pop();
 
                 if (meas) {
                     auto z = std::make_unique<StandardOperation>(qubits[0] + T.zero_qubit, OpType::Z);
@@ -408,31 +437,31 @@ std::string MunichSimulatorAdapter::execute_shot_(
         }
         case constants::RCONTROL:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0]) || G.qc_meas[inst.at("qpus")[0]].empty()) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
-            int meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            int meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
             
             if (meas2) {
                 auto x = std::make_unique<StandardOperation>(G.n_qubits - 1, OpType::X);
                 applyOperationToStateAdapter(std::move(x));
             }
 
-            for(const auto& sub_inst: inst.at("instructions")) {
-                apply_next_instr(T, sub_inst);
+            for (const auto& sub_inst: T.circuit->block(inst)) {
+                apply_next_instr(T, &sub_inst);
             }
 
             auto h = std::make_unique<StandardOperation>(G.n_qubits - 1, OpType::H);
             applyOperationToStateAdapter(std::move(h));
 
             int result = measureAdapter(G.n_qubits - 1) - '0';
-            G.qc_meas[T.id].push(result);
+            G.qc_meas[T.index].push(result);
 
 
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             T.blocked = false;
             break;
         }
@@ -441,39 +470,33 @@ std::string MunichSimulatorAdapter::execute_shot_(
         } // End switch
     };
 
-    while (!G.ended)
+    // Tasks still blocked when none can go on are waiting for messages never sent
+    while (!ready.empty())
     {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
+        auto& T = Ts[ready.pop()];
+        while (!T.blocked && !T.finished)
         {
-            if (T.finished)
-                continue;
-            else if(T.blocked) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, {});
+            apply_next_instr(T, nullptr);
+            if (T.blocked)
+                break;
 
-            if (!T.blocked)
-                ++T.it;
-
-            if (T.it != T.end)
-                G.ended = false;
-            else
+            bool woke_up_other = ready.yield();
+            if (++T.it == T.end) {
                 T.finished = true;
+            } else if (woke_up_other) {
+                ready.push(T.index);
+                break;
+            }
         }
-
     } // End one shot
 
-    // result is a map from the cbit index to the Boolean value
-    std::string result_bits(G.n_clbits, '0');
-    for (const auto &[bitIndex, value] : G.creg)
-    {
-        result_bits[G.n_clbits - bitIndex - 1] = value ? '1' : '0';
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            throw std::runtime_error("Task " + T.id + " is blocked waiting for a message that is never sent.");
     }
 
-    return result_bits;
+    // result is a map from the cbit index to the Boolean value
+    return std::move(G.creg);
 }
 
 JSON MunichSimulatorAdapter::simulate(const Backend* backend)
@@ -540,7 +563,7 @@ JSON MunichSimulatorAdapter::simulate(comm::ClassicalChannel *classical_channel,
     LOGGER_DEBUG("Munich dynamic simulation");
     // TODO: Avoid the static casting?
     auto p_qca = static_cast<QuantumComputationAdapter *>(qc.get());
-    std::map<std::string, std::size_t> meas_counter;
+    ShotCounts meas_counter;
 
     auto shots = p_qca->quantum_tasks[0].config.at("shots").get<std::size_t>();
 
@@ -552,19 +575,70 @@ JSON MunichSimulatorAdapter::simulate(comm::ClassicalChannel *classical_channel,
     if (size(p_qca->quantum_tasks) > 1)
         n_qubits += 2;
 
+    // Shots exchanging classical messages with other QPUs can not stop half way
+    auto cancelled = [&]() { return !classical_channel && p_qca->quantum_tasks[0].is_cancelled(); };
+
     auto start = std::chrono::high_resolution_clock::now();
+#ifdef OPENMP_IN_QC
+    {
+        // Messages to other QPUs carry their shot, so that shot i here pairs with shot i there
+        // whatever thread runs it
+        std::optional<comm::ShotChannel> shot_channel;
+        if (classical_channel && !allows_qc)
+            shot_channel.emplace(*classical_channel);
+        // Unless the channel can send and receive from several threads at once
+        bool parallel_shots = !shot_channel || classical_channel->concurrent();
+
+        ShotErrors errors;
+        #pragma omp parallel if(parallel_shots) num_threads(shot_threads())
+        {
+            // A simulator per thread, each with its own decision diagram package for all its shots
+            ShotCounts local_counter;
+            std::optional<MunichSimulatorAdapter> simulator;
+            try {
+                simulator.emplace(std::make_unique<QuantumComputationAdapter>(*p_qca));
+            } catch (...) {
+                errors.capture();
+            }
+
+            #pragma omp for
+            for (std::size_t i = 0; i < shots; i++) {
+                if (!simulator || errors.failed() || cancelled())
+                    continue;
+                try {
+                    simulator->start_shot_(n_qubits);
+                    if (shot_channel) {
+                        auto shot = shot_channel->shot(i);
+                        local_counter.add(simulator->execute_shot_(p_qca->quantum_tasks, &shot, allows_qc));
+                    } else {
+                        local_counter.add(simulator->execute_shot_(p_qca->quantum_tasks, classical_channel, allows_qc));
+                    }
+                } catch (...) {
+                    errors.capture();
+                }
+            }
+
+            #pragma omp critical
+            meas_counter.merge(local_counter);
+        }
+        errors.rethrow();
+    }
+#else
     for (std::size_t i = 0; i < shots; i++)
     {   
-        initializeSimulationAdapter(n_qubits);
-        meas_counter[execute_shot_(p_qca->quantum_tasks, classical_channel, allows_qc)]++;
+        if (cancelled())
+            break;
+        start_shot_(n_qubits);
+        meas_counter.add(execute_shot_(p_qca->quantum_tasks, classical_channel, allows_qc));
     } // End all shots
+#endif
 
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<float> duration = end - start;
     float time_taken = duration.count();
 
     JSON result_json = {
-        {"counts", meas_counter},
+        {"counts", meas_counter.to_map()},
         {"time_taken", time_taken}};
     return result_json;
 }
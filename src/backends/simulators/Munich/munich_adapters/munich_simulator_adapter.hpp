@@ -1,7 +1,10 @@
+#include <optional>
+
 #include "CircuitSimulator.hpp"
 
 #include "quantum_computation_adapter.hpp"
 #include "classical_channel/classical_channel.hpp"
+#include "backends/simulators/classical_register.hpp"
 #include "backends/backend.hpp"
 
 #include "utils/json.hpp"
@@ -32,9 +35,15 @@ public:
     JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
 private:
 
-    std::string execute_shot_(
+    std::optional<dd::vEdge> zero_state_; // Kept alive in the package, every shot starts from it
+
+    // Starts a shot from |0...0>, keeping the package with its unique and compute tables
+    void start_shot_(const std::size_t n_qubits);
+
+    template <typename Channel>
+    ClassicalRegister execute_shot_(
         const std::vector<QuantumTask>& quantum_tasks, 
-        comm::ClassicalChannel* classical_channel,
+        Channel* classical_channel,
         const bool allows_qc
     );
     
@@ -1,78 +1,490 @@
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <complex>
 #include <unordered_map>
 #include <stack>
 #include <queue>
 #include <chrono>
 #include <functional>
 #include <cstdlib>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <random>
 
 #include "qulacs_simulator_adapter.hpp"
 
+#ifdef OPENMP_IN_QC
+#include <omp.h>
+#endif
+
 #include "cppsim/circuit.hpp"
 #include "cppsim/gate_factory.hpp"
 #include "cppsim/utility.hpp"
 
 #include "qulacs_utils.hpp"
+#include "backends/simulators/ready_queue.hpp"
+#include "backends/simulators/shot_lanes.hpp"
+#include "backends/simulators/shot_counts.hpp"
+#include "backends/simulators/shot_errors.hpp"
+#include "backends/simulators/shot_threads.hpp"
+#include "classical_channel/shot_channel.hpp"
+#include "backends/simulators/shot_branching.hpp"
 #include "utils/constants.hpp"
 
 #include "logger.hpp"
 
 namespace {
 
-UINT measure_adapter(QuantumState& state, UINT target_index)
+// Index of the `i`-th amplitude with the `target` bit at 0
+inline ITYPE zero_index(const ITYPE i, const UINT target)
 {
-    Random random;
-    auto gate0 = gate::P0(target_index);
-    auto gate1 = gate::P1(target_index);
-    std::vector<QuantumGateBase*> _gate_list = {gate0, gate1};
-    double r = random.uniform();
-
-    double sum = 0.;
-    double org_norm = state.get_squared_norm();
-
-    auto buffer = state.copy();
-    UINT index = 0;
-    for (auto gate : _gate_list) {
-        gate->update_quantum_state(buffer);
-        auto norm = buffer->get_squared_norm() / org_norm;
-        sum += norm;
-        if (r < sum) {
-            state.load(buffer);
-            state.normalize(norm);
-            break;
+    const ITYPE low_mask = (ITYPE{1} << target) - 1;
+    return ((i & ~low_mask) << 1) | (i & low_mask);
+}
+
+// Probability of measuring 1 on `target`, relative to the norm of the state, in a single pass
+double probability_one(const QuantumState& state, const UINT target)
+{
+    const CPPCTYPE* data = state.data_c();
+    const ITYPE mask = ITYPE{1} << target;
+    double p0 = 0., p1 = 0.;
+    for (ITYPE i = 0; i < state.dim / 2; ++i) {
+        const ITYPE zero = zero_index(i, target);
+        p0 += std::norm(data[zero]);
+        p1 += std::norm(data[zero | mask]);
+    }
+    return p1 / (p0 + p1);
+}
+
+// Projects `target` onto `outcome`, which has the given probability, and normalizes the state. 
+// With `to_zero` the kept amplitudes are moved to `target` at 0, as a reset does.
+void collapse(QuantumState& state, const UINT target, const UINT outcome, const double probability, const bool to_zero = false)
+{
+    CPPCTYPE* data = state.data_c();
+    const ITYPE mask = ITYPE{1} << target;
+    const double scale = 1. / std::sqrt(probability);
+    for (ITYPE i = 0; i < state.dim / 2; ++i) {
+        const ITYPE zero = zero_index(i, target);
+        const ITYPE one = zero | mask;
+        if (outcome) {
+            data[zero] = to_zero ? data[one] * scale : CPPCTYPE(0., 0.);
+            data[one] = to_zero ? CPPCTYPE(0., 0.) : data[one] * scale;
         } else {
-            buffer->load(&state);
-            index++;
+            data[zero] *= scale;
+            data[one] = CPPCTYPE(0., 0.);
         }
     }
+}
+
+// Mid-circuit measurement done on the state itself, with no copies nor projector gates
+UINT measure_in_place(QuantumState& state, const UINT target, std::mt19937_64& rng)
+{
+    const double p1 = probability_one(state, target);
+    const UINT outcome = std::uniform_real_distribution<double>(0., 1.)(rng) < p1 ? 1 : 0;
+    collapse(state, target, outcome, outcome ? p1 : 1. - p1);
+    return outcome;
+}
 
-    delete gate0;
-    delete gate1;
-    delete buffer;
+// Measures `target` and leaves it at 0
+void reset_in_place(QuantumState& state, const UINT target, std::mt19937_64& rng)
+{
+    const double p1 = probability_one(state, target);
+    const UINT outcome = std::uniform_real_distribution<double>(0., 1.)(rng) < p1 ? 1 : 0;
+    collapse(state, target, outcome, outcome ? p1 : 1. - p1, true);
+}
+
+// Seed of the random numbers of the measurements, the one in the config of the task if any
+std::uint64_t task_seed(const cunqa::QuantumTask& quantum_task)
+{
+    return quantum_task.config.contains("seed") ? quantum_task.config.at("seed").get<std::uint64_t>() : std::random_device{}();
+}
 
-    return index;
+// Generator of the measurements of the `stream`-th thread running shots
+std::mt19937_64 shot_rng(const std::uint64_t seed, const std::size_t stream)
+{
+    std::seed_seq seq{seed, static_cast<std::uint64_t>(stream)};
+    return std::mt19937_64(seq);
 }
 
-struct LocalCCIDs {
-    std::string sendr;
-    std::string recvr;
+// Applies an instruction that only acts on the state, returns false if it is not one of them
+bool apply_gate(QuantumState& state, const cunqa::Instruction& inst, const cunqa::CompiledCircuit& circuit, 
+                const UINT zero_qubit, const UINT comm_qubit)
+{
+    const auto& qubits = inst.qubits;
+
+    switch (inst.type)
+    {
+    case cunqa::constants::ID:
+        gate::Identity(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::X:
+        gate::X(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::Y:
+        gate::Y(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::Z:
+        gate::Z(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::H:
+        gate::H(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::S:
+        gate::S(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::SDG:
+        gate::Sdag(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::T:
+        gate::T(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::TDG:
+        gate::Tdag(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::SX:
+        gate::sqrtX(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::SXDG:
+        gate::sqrtXdag(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::SY:
+        gate::sqrtY(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::SYDG:
+        gate::sqrtYdag(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::P0:
+        gate::P0(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::P1:
+        gate::P1(qubits[0] + zero_qubit)->update_quantum_state(&state);
+        break;
+    case cunqa::constants::U1: 
+    {
+        auto params = circuit.params(inst);
+        gate::U1(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::RX: 
+    {
+        auto params = circuit.params(inst);
+        gate::RX(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::RY: 
+    {
+        auto params = circuit.params(inst);
+        gate::RY(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::RZ: 
+    {
+        auto params = circuit.params(inst);
+        gate::RZ(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ROTINVX: 
+    {
+        auto params = circuit.params(inst);
+        gate::RotInvX(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ROTINVY: 
+    {
+        auto params = circuit.params(inst);
+        gate::RotInvY(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ROTINVZ: 
+    {
+        auto params = circuit.params(inst);
+        gate::RotInvZ(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ROTX: 
+    {
+        auto params = circuit.params(inst);
+        gate::RotX(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ROTY: 
+    {
+        auto params = circuit.params(inst);
+        gate::RotY(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ROTZ: 
+    {
+        auto params = circuit.params(inst);
+        gate::RotZ(qubits[0] + zero_qubit, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::U2: 
+    {
+        auto params = circuit.params(inst);
+        gate::U2(qubits[0] + zero_qubit, params[0], params[1])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::U3: 
+    {
+        auto params = circuit.params(inst);
+        gate::U3(qubits[0] + zero_qubit, params[0], params[1], params[2])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::CX:
+    {
+        UINT control = (qubits[0] == -1) ? comm_qubit : qubits[0] + zero_qubit;
+        gate::CNOT(control, qubits[1] + zero_qubit)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::CZ:
+    {
+        UINT control = (qubits[0] == -1) ? comm_qubit : qubits[0] + zero_qubit;
+        gate::CZ(control, qubits[1] + zero_qubit)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::ECR:
+    {
+        gate::ECR(qubits[0] + zero_qubit, qubits[1] + zero_qubit)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::SWAP:
+    {
+        gate::SWAP(qubits[0] + zero_qubit, qubits[1] + zero_qubit)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::FUSEDSWAP:
+    {
+        auto block_size = circuit.extra(inst).at("block_size").get<unsigned int>();
+        gate::FusedSWAP(qubits[0] + zero_qubit, qubits[1] + zero_qubit, block_size)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::MULTIPAULI:
+    {
+        auto pauli_id_list = circuit.extra(inst).at("pauli_id_list").get<std::vector<unsigned int>>();
+        std::vector<unsigned int> uiqubits;
+        for (int i = 0; i < qubits.size(); i++) {
+            uiqubits.push_back(qubits[i] + zero_qubit);
+        }
+        gate::Pauli(uiqubits, pauli_id_list)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::MULTIPAULIROTATION:
+    {
+        auto params = circuit.params(inst);
+        auto pauli_id_list = circuit.extra(inst).at("pauli_id_list").get<std::vector<unsigned int>>();
+        std::vector<unsigned int> uiqubits;
+        for (int i = 0; i < qubits.size(); i++) {
+            uiqubits.push_back(qubits[i] + zero_qubit);
+        }
+        gate::PauliRotation(uiqubits, pauli_id_list, params[0])->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::UNITARY:
+    {
+        auto cunqa_matrix = circuit.extra(inst).at("matrix").get<std::vector<CunqaQulacsMatrix>>()[0];
+        ComplexMatrix qulacs_matrix = cunqa::sim::cunqamatrix_to_qulacsdensematrix(cunqa_matrix);
 
-    bool operator==(const LocalCCIDs& other) const {
-        return sendr == other.sendr && recvr == other.recvr;
+        if (qubits.size() > 1) {
+            std::vector<unsigned int> uiqubits;
+            for (int i = 0; i < qubits.size(); i++) {
+                uiqubits.push_back(qubits[i] + zero_qubit);
+            }
+            gate::DenseMatrix(uiqubits, qulacs_matrix)->update_quantum_state(&state);
+        } else {
+            gate::DenseMatrix(qubits[0] + zero_qubit, qulacs_matrix)->update_quantum_state(&state);
+        }
+        break;
     }
-}; // Struct to mimic classical communications when vQPUs deployed with quantum communications
+    case cunqa::constants::SPARSEMATRIX:
+    {
+        auto cunqa_matrix = circuit.extra(inst).at("matrix").get<std::vector<CunqaQulacsMatrix>>()[0];
+        SparseComplexMatrix qulacs_sparse = cunqa::sim::cunqamatrix_to_sparse(cunqa_matrix);
 
-struct LocalIDsHash {
-    std::size_t operator()(const LocalCCIDs& local_cc_ids) const noexcept {
-        std::size_t h1 = std::hash<std::string>{}(local_cc_ids.sendr);
-        std::size_t h2 = std::hash<std::string>{}(local_cc_ids.recvr);
-        return h1 ^ (h2 << 1);
+        std::vector<unsigned int> uiqubits;
+        for (int i = 0; i < qubits.size(); i++) {
+            uiqubits.push_back(qubits[i] + zero_qubit);
+        }
+        gate::SparseMatrix(uiqubits, qulacs_sparse)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::DIAGONAL:
+    {   
+        auto cunqa_diagonal = circuit.extra(inst).at("matrix").get<std::vector<CunqaQulacsDiagonalMatrix>>()[0];
+        ComplexVector qulacs_diagonal = cunqa::sim::cunqadiagonal_to_qulacsdiagonal(cunqa_diagonal);
+        std::vector<unsigned int> uiqubits;
+        for (int i = 0; i < qubits.size(); i++) {
+            uiqubits.push_back(qubits[i] + zero_qubit);
+        }
+        gate::DiagonalMatrix(uiqubits, qulacs_diagonal)->update_quantum_state(&state);
+        break;
+    }
+    case cunqa::constants::RANDOMUNITARY:
+    {
+        std::vector<unsigned int> uiqubits;
+        for (int i = 0; i < qubits.size(); i++) {
+            uiqubits.push_back(qubits[i] + zero_qubit);
+        }
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::RandomUnitary(uiqubits, seed)->update_quantum_state(&state);
+        } else {
+            gate::RandomUnitary(uiqubits)->update_quantum_state(&state);
+        }
+        break;
+    }
+    case cunqa::constants::BITFLIPNOISE:
+    {
+        auto prob = circuit.params(inst)[0];
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::BitFlipNoise(qubits[0], prob, seed)->update_quantum_state(&state);
+        } else {
+            gate::BitFlipNoise(qubits[0], prob)->update_quantum_state(&state);
+        }
+        break;
+    }
+    case cunqa::constants::DEPHASINGNOISE:
+    {
+        auto prob = circuit.params(inst)[0];
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::DephasingNoise(qubits[0], prob, seed)->update_quantum_state(&state);
+        } else {
+            gate::DephasingNoise(qubits[0], prob)->update_quantum_state(&state);
+        }
+        break;
+    }
+    case cunqa::constants::INDEPENDENTXZNOISE:
+    {
+        auto prob = circuit.params(inst)[0];
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::IndependentXZNoise(qubits[0], prob, seed)->update_quantum_state(&state);
+        } else {
+            gate::IndependentXZNoise(qubits[0], prob)->update_quantum_state(&state);
+        }
+        break;
+    }
+    case cunqa::constants::DEPOLARIZINGNOISE:
+    {
+        auto prob = circuit.params(inst)[0];
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::DepolarizingNoise(qubits[0], prob, seed)->update_quantum_state(&state);
+        } else {
+            gate::DepolarizingNoise(qubits[0], prob)->update_quantum_state(&state);
+        }
+        break;
+    }
+    case cunqa::constants::TWOQUBITDEPOLARIZINGNOISE:
+    {
+        auto prob = circuit.params(inst)[0];
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::TwoQubitDepolarizingNoise(qubits[0], qubits[1], prob, seed)->update_quantum_state(&state);
+        } else {
+            gate::TwoQubitDepolarizingNoise(qubits[0], qubits[1], prob)->update_quantum_state(&state);
+        }
+        break;
+    }
+    case cunqa::constants::AMPLITUDEDAMPINGNOISE:
+    {
+        auto prob = circuit.params(inst)[0];
+        if (inst.extra >= 0 && circuit.extra(inst).contains("seed")) {
+            auto seed = circuit.extra(inst).at("seed").get<unsigned int>();
+            gate::AmplitudeDampingNoise(qubits[0], prob, seed)->update_quantum_state(&state);
+        } else {
+            gate::AmplitudeDampingNoise(qubits[0], prob)->update_quantum_state(&state);
+        }
+        break;
+    }
+    default:
+        return false;
+    } // End switch
+    return true;
+}
+
+// Whether applying the instruction always leaves the same normalized state. Noise and 
+// random unitaries are sampled on every application, projectors do not normalize.
+bool is_deterministic(const cunqa::Instruction& inst)
+{
+    switch (inst.type) {
+        case cunqa::constants::RANDOMUNITARY:
+        case cunqa::constants::BITFLIPNOISE:
+        case cunqa::constants::DEPHASINGNOISE:
+        case cunqa::constants::INDEPENDENTXZNOISE:
+        case cunqa::constants::DEPOLARIZINGNOISE:
+        case cunqa::constants::TWOQUBITDEPOLARIZINGNOISE:
+        case cunqa::constants::AMPLITUDEDAMPINGNOISE:
+        case cunqa::constants::P0:
+        case cunqa::constants::P1:
+        case cunqa::constants::RESET: // Measures the qubit
+            return false;
+        default:
+            return true;
+    }
+}
+
+// What the shot branching engine needs from Qulacs states
+struct QulacsBranchingOps {
+    const cunqa::CompiledCircuit& circuit;
+    UINT n_qubits;
+
+    bool supports(const cunqa::Instruction& inst) const { return is_deterministic(inst); }
+
+    bool apply(std::unique_ptr<QuantumState>& state, const cunqa::Instruction& inst)
+    {
+        return apply_gate(*state, inst, circuit, 0, n_qubits - 1);
+    }
+
+    double probability_one(const std::unique_ptr<QuantumState>& state, const int qubit)
+    {
+        return ::probability_one(*state, qubit);
+    }
+
+    void collapse(std::unique_ptr<QuantumState>& state, const int qubit, const int outcome, const double probability)
+    {
+        ::collapse(*state, qubit, outcome, probability);
+    }
+
+    std::unique_ptr<QuantumState> clone(const std::unique_ptr<QuantumState>& state)
+    {
+        return std::unique_ptr<QuantumState>(static_cast<QuantumState*>(state->copy()));
     }
 };
 
+// Counts of a dynamic circuit without communications simulated once per measurement outcome,
+// nullopt if it has to be simulated shot by shot
+std::optional<std::map<std::string, std::size_t>> run_shot_branching(const cunqa::QuantumTask& quantum_task, const std::size_t shots)
+{
+    const auto& circuit = quantum_task.compiled();
+    auto n_qubits = quantum_task.config.at("num_qubits").get<UINT>();
+    auto n_clbits = quantum_task.config.at("num_clbits").get<std::size_t>();
+
+    // Each branch holds a whole state vector
+    std::size_t state_bytes = n_qubits < 58 ? sizeof(CPPCTYPE) << n_qubits : SIZE_MAX;
+
+    QulacsBranchingOps ops{circuit, n_qubits};
+    cunqa::sim::ShotBranching<std::unique_ptr<QuantumState>, QulacsBranchingOps> branching(
+        circuit, n_clbits, ops, cunqa::sim::max_branches(shots, state_bytes));
+    if (!branching.worthwhile(shots) || !branching.supported())
+        return std::nullopt;
+
+    std::mt19937_64 rng(task_seed(quantum_task));
+    return branching.run(std::make_unique<QuantumState>(n_qubits), shots, rng);
+}
+
 struct TaskState {
     std::string id;
-    cunqa::JSON::const_iterator it, end;
+    std::size_t index = 0;
+    std::vector<std::size_t> peers; // Task of each QPU the circuit refers to, in the order of the circuit
+    const cunqa::CompiledCircuit* circuit = nullptr;
+    const cunqa::Instruction* it = nullptr;
+    const cunqa::Instruction* end = nullptr;
     UINT zero_qubit = 0;
     UINT zero_clbit = 0;
     bool finished = false;
@@ -82,33 +494,63 @@ struct TaskState {
 
 struct GlobalState {
     unsigned long n_qubits = 0, n_clbits = 0;
-    std::map<std::size_t, bool> creg;
-    std::unordered_map<std::string, std::stack<UINT>> qc_meas;
-    std::unordered_map<LocalCCIDs, std::queue<UINT>, LocalIDsHash> local_cc_queue; // To mimic classical communications when executing with quantum communications
-    bool ended = false;
+    cunqa::sim::ClassicalRegister creg;
+    std::vector<std::stack<UINT>> qc_meas; // By task
+    std::vector<std::queue<UINT>> local_cc_queue; // By sender * n_tasks + receiver, to mimic classical communications when executing with quantum communications
 };
  
-std::string execute_shot_(
+// Applies to the state the gates every shot starts with, up to the first measurement, 
+// communication or non deterministic gate of each task. Returns how many of each task were applied.
+std::vector<std::size_t> apply_deterministic_prefix(QuantumState& state, const std::vector<cunqa::QuantumTask>& quantum_tasks)
+{
+    std::vector<std::size_t> prefix_lengths;
+    UINT zero_qubit = 0;
+    for (const auto& quantum_task : quantum_tasks) {
+        const auto& circuit = quantum_task.compiled();
+        std::size_t length = 0;
+        for (const auto& inst : circuit) {
+            if (!is_deterministic(inst) || std::find(inst.qubits.begin(), inst.qubits.end(), -1) != inst.qubits.end())
+                break;
+            // Measurements, communications and the other instructions touching the clbits are not gates
+            if (!apply_gate(state, inst, circuit, zero_qubit, 0))
+                break;
+            ++length;
+        }
+        prefix_lengths.push_back(length);
+        zero_qubit += quantum_task.config.at("num_qubits").get<UINT>();
+    }
+    return prefix_lengths;
+}
+
+// `prefix_lengths`, if given, are the instructions of each task already applied to the state.
+// `classical_channel` is a comm::ClassicalChannel or a lane of a comm::LaneChannel.
+template <typename Channel>
+cunqa::sim::ClassicalRegister execute_shot_(
     QuantumState& state, 
+    std::mt19937_64& rng,
     const std::vector<cunqa::QuantumTask>& quantum_tasks, 
-    cunqa::comm::ClassicalChannel* classical_channel,
-    const bool allows_qc
+    Channel* classical_channel,
+    const bool allows_qc,
+    const std::vector<std::size_t>* prefix_lengths = nullptr
 )
 {
-    std::unordered_map<std::string, TaskState> Ts;
+    std::vector<TaskState> Ts;
     GlobalState G;
 
-    for (auto &quantum_task : quantum_tasks)
+    for (std::size_t i = 0; i < quantum_tasks.size(); ++i)
     {
+        const auto& quantum_task = quantum_tasks[i];
         TaskState T;
         T.id = quantum_task.id;
         T.zero_qubit = G.n_qubits;
         T.zero_clbit = G.n_clbits;
-        T.it = quantum_task.circuit.begin();
-        T.end = quantum_task.circuit.end();
+        T.circuit = &quantum_task.compiled();
+        T.it = T.circuit->begin() + (prefix_lengths ? (*prefix_lengths)[i] : 0);
+        T.end = T.circuit->end();
         T.blocked = false;
-        T.finished = false;
-        Ts[quantum_task.id] = T;
+        T.finished = T.it == T.end;
+        T.index = Ts.size();
+        Ts.push_back(T);
         
         G.n_qubits += quantum_task.config.at("num_qubits").get<int>();
         G.n_clbits += quantum_task.config.at("num_clbits").get<int>();
@@ -118,12 +560,37 @@ std::string execute_shot_(
     if (size(quantum_tasks) > 1)
         G.n_qubits += 2;
 
+    G.creg = cunqa::sim::ClassicalRegister(G.n_clbits);
+
+    // The QPUs named by the communications, resolved once to their tasks. QPUs outside the 
+    // job are only reached through the classical channel.
+    for (auto& T : Ts) {
+        for (const auto& qpu : T.circuit->qpus()) {
+            auto peer = std::find_if(Ts.begin(), Ts.end(), [&](const TaskState& other) { return other.id == qpu; });
+            T.peers.push_back(peer != Ts.end() ? peer->index : T.index);
+        }
+    }
+    G.qc_meas.resize(Ts.size());
+    G.local_cc_queue.resize(Ts.size() * Ts.size());
+
+    cunqa::sim::ReadyQueue ready;
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            ready.push(T.index);
+    }
+    auto wake = [&](const std::size_t task) {
+        if (Ts[task].blocked) {
+            Ts[task].blocked = false;
+            ready.wake(task);
+        }
+    };
+
     auto generate_entanglement_ = [&]() {
-        UINT meas1 = measure_adapter(state, G.n_qubits - 1);
+        UINT meas1 = measure_in_place(state, G.n_qubits - 1, rng);
         if (meas1) {
             gate::X(G.n_qubits - 1)->update_quantum_state(&state);
         }
-        UINT meas2 = measure_adapter(state, G.n_qubits - 2);
+        UINT meas2 = measure_in_place(state, G.n_qubits - 2, rng);
         if (meas2) {
             gate::X(G.n_qubits - 2)->update_quantum_state(&state);
         }
@@ -132,337 +599,48 @@ std::string execute_shot_(
     };
 
 
-    std::function<void(TaskState&, const cunqa::JSON&)> apply_next_instr = 
-        [&](TaskState& T, const cunqa::JSON& instruction = {}) 
+    std::function<void(TaskState&, const cunqa::Instruction*)> apply_next_instr = 
+        [&](TaskState& T, const cunqa::Instruction* instruction = nullptr) 
     {
-        const cunqa::JSON& inst = instruction.empty() ? *T.it : instruction;
-
-        std::vector<int> qubits;
-        if (inst.contains("qubits"))
-            qubits = inst.at("qubits").get<std::vector<int>>();
-        auto inst_type = cunqa::constants::INSTRUCTIONS_MAP.at(inst.at("name").get<std::string>());
+        const cunqa::Instruction& inst = instruction ? *instruction : *T.it;
+        const auto& qubits = inst.qubits;
+        auto inst_type = inst.type;
 
         switch (inst_type)
         {
         case cunqa::constants::MEASURE:
         {
-            UINT measurement = measure_adapter(state, qubits[0] + T.zero_qubit);
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            UINT measurement = measure_in_place(state, qubits[0] + T.zero_qubit, rng);
+            const auto& clbits = inst.clbits;
             G.creg[clbits[0] + T.zero_clbit] = (measurement == 1);
             break;
         }
-        case cunqa::constants::COPY:
+        case cunqa::constants::RESET:
         {
-            auto l_clbits = inst.at("l_clbits").get<std::vector<int>>();
-            auto r_clbits = inst.at("r_clbits").get<std::vector<int>>();
-
-            if(l_clbits.size() != r_clbits.size())
-                throw std::runtime_error("The number of copied clbits and the number of clbits "
-                                         "copied on does not match.");
-
-            for (size_t i = 0; i < l_clbits.size(); ++i)
-                G.creg[l_clbits[i] + T.zero_clbit] = G.creg[r_clbits[i] + T.zero_clbit];
-                
+            reset_in_place(state, qubits[0] + T.zero_qubit, rng);
             break;
         }
-        case cunqa::constants::ID:
-            gate::Identity(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::X:
-            gate::X(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::Y:
-            gate::Y(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::Z:
-            gate::Z(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::H:
-            gate::H(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::S:
-            gate::S(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::SDG:
-            gate::Sdag(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::T:
-            gate::T(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::TDG:
-            gate::Tdag(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::SX:
-            gate::sqrtX(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::SXDG:
-            gate::sqrtXdag(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::SY:
-            gate::sqrtY(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::SYDG:
-            gate::sqrtYdag(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::P0:
-            gate::P0(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::P1:
-            gate::P1(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        case cunqa::constants::U1: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::U1(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::RX: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RX(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::RY: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RY(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::RZ: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RZ(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ROTINVX: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RotInvX(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ROTINVY: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RotInvY(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ROTINVZ: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RotInvZ(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ROTX: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RotX(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ROTY: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RotY(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ROTZ: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::RotZ(qubits[0] + T.zero_qubit, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::U2: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::U2(qubits[0] + T.zero_qubit, params[0], params[1])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::U3: 
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            gate::U3(qubits[0] + T.zero_qubit, params[0], params[1], params[2])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::CX:
-        {
-            UINT control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
-            gate::CNOT(control, qubits[1] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::CZ:
-        {
-            UINT control = (qubits[0] == -1) ? G.n_qubits - 1 : qubits[0] + T.zero_qubit;
-            gate::CZ(control, qubits[1] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::ECR:
-        {
-            gate::ECR(qubits[0] + T.zero_qubit, qubits[1] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::SWAP:
-        {
-            gate::SWAP(qubits[0] + T.zero_qubit, qubits[1] + T.zero_qubit)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::FUSEDSWAP:
-        {
-            auto block_size = inst.at("block_size").get<unsigned int>();
-            gate::FusedSWAP(qubits[0] + T.zero_qubit, qubits[1] + T.zero_qubit, block_size)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::MULTIPAULI:
-        {
-            auto pauli_id_list = inst.at("pauli_id_list").get<std::vector<unsigned int>>();
-            std::vector<unsigned int> uiqubits;
-            for (int i = 0; i < qubits.size(); i++) {
-                uiqubits.push_back(qubits[i] + T.zero_qubit);
-            }
-            gate::Pauli(uiqubits, pauli_id_list)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::MULTIPAULIROTATION:
-        {
-            auto params = inst.at("params").get<std::vector<double>>();
-            auto pauli_id_list = inst.at("pauli_id_list").get<std::vector<unsigned int>>();
-            std::vector<unsigned int> uiqubits;
-            for (int i = 0; i < qubits.size(); i++) {
-                uiqubits.push_back(qubits[i] + T.zero_qubit);
-            }
-            gate::PauliRotation(uiqubits, pauli_id_list, params[0])->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::UNITARY:
-        {
-            auto cunqa_matrix = inst.at("matrix").get<std::vector<CunqaQulacsMatrix>>()[0];
-            ComplexMatrix qulacs_matrix = cunqa::sim::cunqamatrix_to_qulacsdensematrix(cunqa_matrix);
-
-            if (qubits.size() > 1) {
-                std::vector<unsigned int> uiqubits;
-                for (int i = 0; i < qubits.size(); i++) {
-                    uiqubits.push_back(qubits[i] + T.zero_qubit);
-                }
-                gate::DenseMatrix(uiqubits, qulacs_matrix)->update_quantum_state(&state);
-            } else {
-                gate::DenseMatrix(qubits[0] + T.zero_qubit, qulacs_matrix)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::SPARSEMATRIX:
-        {
-            auto cunqa_matrix = inst.at("matrix").get<std::vector<CunqaQulacsMatrix>>()[0];
-            SparseComplexMatrix qulacs_sparse = cunqa::sim::cunqamatrix_to_sparse(cunqa_matrix);
-
-            std::vector<unsigned int> uiqubits;
-            for (int i = 0; i < qubits.size(); i++) {
-                uiqubits.push_back(qubits[i] + T.zero_qubit);
-            }
-            gate::SparseMatrix(uiqubits, qulacs_sparse)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::DIAGONAL:
-        {   
-            auto cunqa_diagonal = inst.at("matrix").get<std::vector<CunqaQulacsDiagonalMatrix>>()[0];
-            ComplexVector qulacs_diagonal = cunqa::sim::cunqadiagonal_to_qulacsdiagonal(cunqa_diagonal);
-            std::vector<unsigned int> uiqubits;
-            for (int i = 0; i < qubits.size(); i++) {
-                uiqubits.push_back(qubits[i] + T.zero_qubit);
-            }
-            gate::DiagonalMatrix(uiqubits, qulacs_diagonal)->update_quantum_state(&state);
-            break;
-        }
-        case cunqa::constants::RANDOMUNITARY:
-        {
-            std::vector<unsigned int> uiqubits;
-            for (int i = 0; i < qubits.size(); i++) {
-                uiqubits.push_back(qubits[i] + T.zero_qubit);
-            }
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::RandomUnitary(uiqubits, seed)->update_quantum_state(&state);
-            } else {
-                gate::RandomUnitary(uiqubits)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::BITFLIPNOISE:
-        {
-            auto prob = inst.at("params").get<double>();
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::BitFlipNoise(qubits[0], prob, seed)->update_quantum_state(&state);
-            } else {
-                gate::BitFlipNoise(qubits[0], prob)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::DEPHASINGNOISE:
-        {
-            auto prob = inst.at("params").get<double>();
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::DephasingNoise(qubits[0], prob, seed)->update_quantum_state(&state);
-            } else {
-                gate::DephasingNoise(qubits[0], prob)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::INDEPENDENTXZNOISE:
-        {
-            auto prob = inst.at("params").get<double>();
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::IndependentXZNoise(qubits[0], prob, seed)->update_quantum_state(&state);
-            } else {
-                gate::IndependentXZNoise(qubits[0], prob)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::DEPOLARIZINGNOISE:
-        {
-            auto prob = inst.at("params").get<double>();
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::DepolarizingNoise(qubits[0], prob, seed)->update_quantum_state(&state);
-            } else {
-                gate::DepolarizingNoise(qubits[0], prob)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::TWOQUBITDEPOLARIZINGNOISE:
-        {
-            auto prob = inst.at("params").get<double>();
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::TwoQubitDepolarizingNoise(qubits[0], qubits[1], prob, seed)->update_quantum_state(&state);
-            } else {
-                gate::TwoQubitDepolarizingNoise(qubits[0], qubits[1], prob)->update_quantum_state(&state);
-            }
-            break;
-        }
-        case cunqa::constants::AMPLITUDEDAMPINGNOISE:
+        case cunqa::constants::COPY:
         {
-            auto prob = inst.at("params").get<double>();
-            if (inst.contains("seed")) {
-                auto seed = inst.at("seed").get<unsigned int>();
-                gate::AmplitudeDampingNoise(qubits[0], prob, seed)->update_quantum_state(&state);
-            } else {
-                gate::AmplitudeDampingNoise(qubits[0], prob)->update_quantum_state(&state);
-            }
+            // l_clbits followed by as many r_clbits
+            const auto& clbits = inst.clbits;
+            std::size_t n_copied = clbits.size() / 2;
+            for (size_t i = 0; i < n_copied; ++i)
+                G.creg[clbits[i] + T.zero_clbit] = G.creg[clbits[n_copied + i] + T.zero_clbit];
+                
             break;
         }
         case cunqa::constants::SEND:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();   
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;   
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = T.id, 
-                    .recvr = Ts[qpu_id].id
-                };  
+                auto& queue = G.local_cc_queue[T.index * Ts.size() + T.peers[inst.qpu]];
                 for (auto& clbit : clbits) {
-                    G.local_cc_queue[local_cc_ids].push(G.creg[clbit + T.zero_clbit]);
+                    queue.push(G.creg[clbit + T.zero_clbit]);
                 }
+                wake(T.peers[inst.qpu]);
             } else {
                 for (const auto& clbit: clbits) {
                     classical_channel->send_measure(G.creg[clbit + T.zero_clbit], qpu_id);
@@ -472,18 +650,15 @@ std::string execute_shot_(
         }
         case cunqa::constants::RECV:
         {
-            auto qpu_id = inst.at("qpus").get<std::vector<std::string>>()[0];
-            auto clbits = inst.at("clbits").get<std::vector<int>>();
+            const auto& qpu_id = T.circuit->qpu(inst);
+            const auto& clbits = inst.clbits;
 
             if (allows_qc) {
-                LocalCCIDs local_cc_ids = {
-                    .sendr = Ts[qpu_id].id, 
-                    .recvr = T.id
-                };
-                if (G.local_cc_queue.contains(local_cc_ids) && !G.local_cc_queue.at(local_cc_ids).empty()) {
+                auto& queue = G.local_cc_queue[T.peers[inst.qpu] * Ts.size() + T.index];
+                if (!queue.empty()) {
                     for (const auto& clbit: clbits) {
-                        G.creg[clbit + T.zero_clbit] = (G.local_cc_queue.at(local_cc_ids).front() == 1);
-                        G.local_cc_queue.at(local_cc_ids).pop();
+                        G.creg[clbit + T.zero_clbit] = (queue.front() == 1);
+                        queue.pop();
                     }
                     T.blocked = false;
                 } else {
@@ -499,10 +674,10 @@ std::string execute_shot_(
         }
         case cunqa::constants::CIF:
         {
-            const auto& clbits = inst.at("clbits").get<std::vector<int>>();
-            if (G.creg[clbits.at(0) + T.zero_clbit]) {
-                for(const auto& sub_inst: inst.at("instructions")) {
-                    apply_next_instr(T, sub_inst);
+            const auto& clbits = inst.clbits;
+            if (G.creg[clbits[0] + T.zero_clbit]) {
+                for (const auto& sub_inst: T.circuit->block(inst)) {
+                    apply_next_instr(T, &sub_inst);
                 }
             }
             break;
@@ -519,31 +694,31 @@ std::string execute_shot_(
             // H to the sent qubit
             gate::H(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
 
-            UINT result = measure_adapter(state, qubits[0] + T.zero_qubit);
+            UINT result = measure_in_place(state, qubits[0] + T.zero_qubit, rng);
 
-            G.qc_meas[T.id].push(result);
-            G.qc_meas[T.id].push(measure_adapter(state, G.n_qubits - 2));
+            G.qc_meas[T.index].push(result);
+            G.qc_meas[T.index].push(measure_in_place(state, G.n_qubits - 2, rng));
 
             if (result) {
                 gate::X(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
             }
 
             // Unlock QRECV
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             break;
         }
         case cunqa::constants::QRECV:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0])) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
             // Receive the measurements from the sender
-            std::size_t meas1 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
-            std::size_t meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            std::size_t meas1 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
+            std::size_t meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             // Apply, conditioned to the measurement, the X and Z gates
             if (meas1) {
@@ -565,16 +740,16 @@ std::string execute_shot_(
                 // CX to the entangled pair
                 gate::CNOT(qubits[0] + T.zero_qubit, G.n_qubits - 2)->update_quantum_state(&state);
 
-                UINT result = measure_adapter(state, G.n_qubits - 2);
+                UINT result = measure_in_place(state, G.n_qubits - 2, rng);
 
-                G.qc_meas[T.id].push(result);
+                G.qc_meas[T.index].push(result);
                 T.cat_entangled = true;
                 T.blocked = true;
-                Ts[inst.at("qpus")[0]].blocked = false;
+                wake(T.peers[inst.qpu]);
                 return;
             } else {
-                UINT meas = G.qc_meas[inst.at("qpus")[0]].top();
-                G.qc_meas[inst.at("qpus")[0]].pop();
+                UINT meas = G.qc_meas[T.peers[inst.qpu]].top();
+                G.qc_meas[T.peers[inst.qpu]].pop();
 
                 if (meas) {
                     gate::Z(qubits[0] + T.zero_qubit)->update_quantum_state(&state);
@@ -586,68 +761,63 @@ std::string execute_shot_(
         }
         case cunqa::constants::RCONTROL:
         {
-            if (!G.qc_meas.contains(inst.at("qpus")[0]) || G.qc_meas[inst.at("qpus")[0]].empty()) {
+            if (G.qc_meas[T.peers[inst.qpu]].empty()) {
                 T.blocked = true;
                 return;
             }
 
-            UINT meas2 = G.qc_meas[inst.at("qpus")[0]].top();
-            G.qc_meas[inst.at("qpus")[0]].pop();
+            UINT meas2 = G.qc_meas[T.peers[inst.qpu]].top();
+            G.qc_meas[T.peers[inst.qpu]].pop();
 
             if (meas2) {
                 gate::X(G.n_qubits - 1)->update_quantum_state(&state);
             }
 
-            for(const auto& sub_inst: inst.at("instructions")) {
-                apply_next_instr(T, sub_inst);
+            for (const auto& sub_inst: T.circuit->block(inst)) {
+                apply_next_instr(T, &sub_inst);
             }
 
             gate::H(G.n_qubits - 1)->update_quantum_state(&state);
 
-            UINT result = measure_adapter(state, G.n_qubits - 1);
-            G.qc_meas[T.id].push(result);
+            UINT result = measure_in_place(state, G.n_qubits - 1, rng);
+            G.qc_meas[T.index].push(result);
 
-            Ts[inst.at("qpus")[0]].blocked = false;
+            wake(T.peers[inst.qpu]);
             T.blocked = false;
             break;
         }
         default:
-            std::cerr << "Instruction not suported!" << "\n" << "Instruction that failed: " << inst.dump(4) << "\n";
+            if (!apply_gate(state, inst, *T.circuit, T.zero_qubit, G.n_qubits - 1))
+                std::cerr << "Instruction not suported!" << "\n" << "Instruction that failed: " << *inst.name << "\n";
         } // End switch
     };
 
-    while (!G.ended)
+    // Tasks still blocked when none can go on are waiting for messages never sent
+    while (!ready.empty())
     {
-        G.ended = true;
-        for (auto& [id, T]: Ts)
+        auto& T = Ts[ready.pop()];
+        while (!T.blocked && !T.finished)
         {
-            if (T.finished)
-                continue;
-            else if(T.blocked) {
-                G.ended = false;
-                continue;
-            }
-
-            apply_next_instr(T, {});
-
-            if (!T.blocked)
-                ++T.it;
+            apply_next_instr(T, nullptr);
+            if (T.blocked)
+                break;
 
-            if (T.it != T.end)
-                G.ended = false;
-            else
+            bool woke_up_other = ready.yield();
+            if (++T.it == T.end) {
                 T.finished = true;
+            } else if (woke_up_other) {
+                ready.push(T.index);
+                break;
+            }
         }
-
     } // End one shot
 
-    std::string result_bits(G.n_clbits, '0');
-    for (const auto &[bitIndex, value] : G.creg)
-    {
-        result_bits[G.n_clbits - bitIndex - 1] = value ? '1' : '0';
+    for (const auto& T : Ts) {
+        if (!T.finished)
+            throw std::runtime_error("Task " + T.id + " is blocked waiting for a message that is never sent.");
     }
 
-    return result_bits;
+    return std::move(G.creg);
 }
 
 } // End of anonymous namespace
@@ -696,10 +866,10 @@ JSON QulacsSimulatorAdapter::simulate(const Backend* backend)
 }
 
 
-JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc)
+JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel, const bool allows_qc, const std::size_t shot_lanes)
 {
     LOGGER_DEBUG("Qulacs dynamic simulation");
-    std::map<std::string, std::size_t> meas_counter;
+    ShotCounts meas_counter;
     
     auto shots = qc.quantum_tasks[0].config.at("shots").get<std::size_t>();
 
@@ -711,37 +881,94 @@ JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
     if (size(qc.quantum_tasks) > 1)
         n_qubits += 2;
 
+    // Each thread running shots measures with its own generator, all seeded from the task
+    const std::uint64_t seed = task_seed(qc.quantum_tasks[0]);
+
+    // Shots exchanging classical messages with other QPUs can not stop half way
+    auto cancelled = [&]() { return !classical_channel && qc.quantum_tasks[0].is_cancelled(); };
+
     auto start = std::chrono::high_resolution_clock::now();
+    if (size(qc.quantum_tasks) == 1 && !classical_channel) {
+        if (auto counts = run_shot_branching(qc.quantum_tasks[0], shots)) {
+            LOGGER_DEBUG("Dynamic circuit simulated by measurement branching.");
+            std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+            return {{"counts", *counts}, {"time_taken", duration.count()}};
+        }
+    }
+    // Each message to the other QPUs carries a measurement of every lane
+    if (classical_channel && !allows_qc && shot_lanes > 1 && classical_channel->concurrent()) {
+        QuantumState initial_state(n_qubits);
+        auto prefix_lengths = apply_deterministic_prefix(initial_state, qc.quantum_tasks);
+        auto counts = run_shot_lanes(*classical_channel, shot_lanes, shots, [&](auto& lane, const std::size_t lane_shots) {
+            ShotCounts lane_counter;
+            auto rng = shot_rng(seed, lane.index());
+            QuantumState state(n_qubits);
+            state.load(&initial_state);
+            for (std::size_t i = 0; i < lane_shots; i++) {
+                lane_counter.add(execute_shot_(state, rng, qc.quantum_tasks, &lane, allows_qc, &prefix_lengths));
+                state.load(&initial_state);
+            }
+            return lane_counter;
+        });
+        std::chrono::duration<float> duration = std::chrono::high_resolution_clock::now() - start;
+        return {{"counts", counts.to_map()}, {"time_taken", duration.count()}};
+    }
 #ifdef OPENMP_IN_QC
-    if (size(qc.quantum_tasks) > 1) { // Quantum communications 
-        #pragma omp parallel
-        {
-            std::map<std::string, std::size_t> local_counter;
-            
+    {
+        // Messages to other QPUs carry their shot, so that shot i here pairs with shot i there
+        // whatever thread runs it
+        std::optional<comm::ShotChannel> shot_channel;
+        if (classical_channel && !allows_qc)
+            shot_channel.emplace(*classical_channel);
+        // Unless the channel can send and receive from several threads at once
+        bool parallel_shots = !shot_channel || classical_channel->concurrent();
+
+        // Every shot starts from the state after the gates before the first measurement
+        QuantumState initial_state(n_qubits);
+        auto prefix_lengths = apply_deterministic_prefix(initial_state, qc.quantum_tasks);
+
+        ShotErrors errors;
+        #pragma omp parallel if(parallel_shots) num_threads(shot_threads())
+        {
+            ShotCounts local_counter;
+            auto rng = shot_rng(seed, omp_get_thread_num());
             QuantumState state(n_qubits);
+            state.load(&initial_state);
 
             #pragma omp for
             for (std::size_t i = 0; i < shots; i++) {
-                local_counter[execute_shot_(state, qc.quantum_tasks, classical_channel, allows_qc)]++;
-                state.set_zero_state();
+                if (errors.failed() || cancelled())
+                    continue;
+                try {
+                    if (shot_channel) {
+                        auto shot = shot_channel->shot(i);
+                        local_counter.add(execute_shot_(state, rng, qc.quantum_tasks, &shot, allows_qc, &prefix_lengths));
+                    } else {
+                        local_counter.add(execute_shot_(state, rng, qc.quantum_tasks, classical_channel, allows_qc, &prefix_lengths));
+                    }
+                    state.load(&initial_state);
+                } catch (...) {
+                    errors.capture();
+                }
             }
 
             #pragma omp critical
-            for (auto& [key, val] : local_counter)
-                meas_counter[key] += val;
+            meas_counter.merge(local_counter);
         }
-    } else { // As if OPENMP_IN_QC not enabled
-        QuantumState state(n_qubits);
-        for (std::size_t i = 0; i < shots; i++) {
-            meas_counter[execute_shot_(state, qc.quantum_tasks, classical_channel, allows_qc)]++;
-            state.set_zero_state();
-        } // End all shots
+        errors.rethrow();
     }
 #else
+    // Every shot starts from the state after the gates before the first measurement
+    QuantumState initial_state(n_qubits);
+    auto prefix_lengths = apply_deterministic_prefix(initial_state, qc.quantum_tasks);
     QuantumState state(n_qubits);
+    state.load(&initial_state);
+    auto rng = shot_rng(seed, 0);
     for (std::size_t i = 0; i < shots; i++) {
-        meas_counter[execute_shot_(state, qc.quantum_tasks, classical_channel, allows_qc)]++;
-        state.set_zero_state();
+        if (cancelled())
+            break;
+        meas_counter.add(execute_shot_(state, rng, qc.quantum_tasks, classical_channel, allows_qc, &prefix_lengths));
+        state.load(&initial_state);
     } // End all shots
 #endif
     auto end = std::chrono::high_resolution_clock::now();
@@ -749,7 +976,7 @@ JSON QulacsSimulatorAdapter::simulate(comm::ClassicalChannel* classical_channel,
     float time_taken = duration.count();
 
     JSON result_json = {
-        {"counts", meas_counter},
+        {"counts", meas_counter.to_map()},
         {"time_taken", time_taken}};
     return result_json;
 }
@@ -18,7 +18,7 @@ public:
     QulacsSimulatorAdapter(QulacsComputationAdapter& qc) : qc{qc} {}
 
     JSON simulate(const Backend* backend);
-    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false);
+    JSON simulate(comm::ClassicalChannel* classical_channel = nullptr, const bool allows_qc = false, const std::size_t shot_lanes = 1);
 
     QulacsComputationAdapter qc;
 
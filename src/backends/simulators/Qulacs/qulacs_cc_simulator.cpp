@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstdlib>
+
 #include "qulacs_cc_simulator.hpp"
 #include "qulacs_adapters/qulacs_computation_adapter.hpp"
 #include "qulacs_adapters/qulacs_simulator_adapter.hpp"
@@ -11,6 +14,8 @@ QulacsCCSimulator::QulacsCCSimulator() :
     classical_channel{std::getenv("SLURM_JOB_ID") + "_"s + std::getenv("SLURM_TASK_PID")}
 {
     classical_channel.publish();
+    if (const char* lanes = std::getenv("CUNQA_QPU_SHOT_LANES"))
+        shot_lanes = std::max(1, std::atoi(lanes));
 };
 
 // Distributed QulacsSimulator
@@ -22,7 +27,7 @@ JSON QulacsCCSimulator::execute(const CCBackend& backend, const QuantumTask& qua
     QulacsComputationAdapter qulacs_ca(quantum_task);
     QulacsSimulatorAdapter qulacs_sa(qulacs_ca);
     if (quantum_task.is_dynamic) {
-        return qulacs_sa.simulate(&classical_channel);
+        return qulacs_sa.simulate(&classical_channel, false, shot_lanes);
     } else {
         return qulacs_sa.simulate(&backend);
     }
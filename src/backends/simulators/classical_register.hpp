@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cunqa {
+namespace sim {
+
+// Classical register of a shot, one bit per clbit packed in 64-bit words. Indexing gives a
+// reference to the bit, so it reads and assigns like a container of bools.
+class ClassicalRegister {
+public:
+    class Bit {
+    public:
+        operator bool() const { return (word_ >> offset_) & 1; }
+
+        Bit& operator=(const bool value)
+        {
+            word_ = (word_ & ~(std::uint64_t{1} << offset_)) | (std::uint64_t{value} << offset_);
+            return *this;
+        }
+        Bit& operator=(const Bit& other) { return *this = static_cast<bool>(other); }
+
+    private:
+        Bit(std::uint64_t& word, const std::size_t offset) : word_{word}, offset_{offset} { }
+
+        std::uint64_t& word_;
+        std::size_t offset_;
+
+        friend class ClassicalRegister;
+    };
+
+    ClassicalRegister() = default;
+    explicit ClassicalRegister(const std::size_t n_clbits) : 
+        n_clbits_{n_clbits},
+        words_((n_clbits + 63) / 64, 0)
+    { }
+
+    Bit operator[](const std::size_t clbit) { return Bit(words_[clbit / 64], clbit % 64); }
+    bool operator[](const std::size_t clbit) const { return (words_[clbit / 64] >> (clbit % 64)) & 1; }
+
+    std::size_t size() const { return n_clbits_; }
+    std::span<const std::uint64_t> words() const { return words_; }
+
+private:
+    std::size_t n_clbits_ = 0;
+    std::vector<std::uint64_t> words_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
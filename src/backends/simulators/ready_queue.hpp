@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <utility>
+
+namespace cunqa {
+namespace sim {
+
+// Tasks of a shot that can go on, by their index in the job. A task runs until it ends or 
+// blocks waiting for another one, which wakes it up when it has done what it was waited for, 
+// so blocked tasks are never polled.
+class ReadyQueue {
+public:
+    void push(const std::size_t task) { ready_.push_back(task); }
+
+    // The woken task goes first, as it was waiting for what the running one has just done
+    void wake(const std::size_t task)
+    {
+        ready_.push_front(task);
+        woken_ = true;
+    }
+
+    bool empty() const { return ready_.empty(); }
+
+    std::size_t pop()
+    {
+        auto task = ready_.front();
+        ready_.pop_front();
+        woken_ = false;
+        return task;
+    }
+
+    // Whether the running task woke up another one since it was popped or last asked
+    bool yield() { return std::exchange(woken_, false); }
+
+private:
+    std::deque<std::size_t> ready_;
+    bool woken_ = false;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "compiled_circuit.hpp"
+#include "utils/constants.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Memory the live branches of a dynamic circuit may take together
+constexpr std::size_t DEFAULT_BRANCHES_BYTES = 1UL << 30;
+
+// Live branches a dynamic circuit may split into before it is simulated shot by shot instead.
+// More branches than shots would cost more than the shots themselves, and every branch holds
+// a whole state.
+inline std::size_t max_branches(const std::size_t shots, const std::size_t state_bytes,
+                                const std::size_t budget_bytes = DEFAULT_BRANCHES_BYTES)
+{
+    return std::min(shots, budget_bytes / std::max<std::size_t>(state_bytes, 1));
+}
+
+// Simulates a dynamic circuit of a single QPU once per measurement outcome instead of once
+// per shot. At each measurement every branch splits in two, weighted by the probability of each
+// outcome, and the counts are sampled at the end from the weights of the branches.
+//
+// The simulator provides, through `ops`, what the engine needs from its states:
+//   bool   supports(const Instruction&)             the instruction is deterministic
+//   bool   apply(State&, const Instruction&)        applies it, false if it is not known
+//   double probability_one(const State&, int qubit)
+//   void   collapse(State&, int qubit, int outcome, double probability)
+//   State  clone(const State&)
+template <typename State, typename Ops>
+class ShotBranching {
+public:
+    ShotBranching(const CompiledCircuit& circuit, const std::size_t n_clbits, Ops& ops,
+                  const std::size_t max_branches) :
+        circuit_{circuit},
+        n_clbits_{n_clbits},
+        ops_{ops},
+        max_branches_{max_branches}
+    { }
+
+    // Whether every instruction is either handled by the engine or deterministic for the simulator.
+    // Measurements, copies and nested blocks inside a "cif", and anything remote, are not.
+    bool supported() const
+    {
+        for (const auto& inst : circuit_) {
+            switch (inst.type) {
+                case constants::MEASURE:
+                case constants::COPY:
+                    break;
+                case constants::CIF:
+                    for (const auto& sub_inst : circuit_.block(inst)) {
+                        if (!is_local_(sub_inst) || !ops_.supports(sub_inst))
+                            return false;
+                    }
+                    break;
+                default:
+                    if (!is_local_(inst) || !ops_.supports(inst))
+                        return false;
+            }
+        }
+        return true;
+    }
+
+    // Whether branching may beat `shots` shots: each measurement can at most double the
+    // branches, and a single branch is no better than a single shot
+    bool worthwhile(const std::size_t shots) const
+    {
+        if (max_branches_ < 2)
+            return false;
+        std::size_t n_measurements = std::count_if(circuit_.begin(), circuit_.end(), [](const Instruction& inst) {
+            return inst.type == constants::MEASURE;
+        });
+        return shots > n_measurements;
+    }
+
+    // Counts of the shots, or nullopt if the branches would go beyond the budget or the 
+    // simulator does not know some instruction
+    std::optional<std::map<std::string, std::size_t>> run(State initial_state, const std::size_t shots, std::mt19937_64& rng)
+    {
+        std::vector<Branch> branches;
+        branches.push_back({std::move(initial_state), 1.0, std::vector<bool>(n_clbits_, false)});
+
+        for (const auto& inst : circuit_) {
+            switch (inst.type) {
+                case constants::MEASURE:
+                    if (!measure_(branches, inst.qubits[0], inst.clbits[0]))
+                        return std::nullopt;
+                    break;
+                case constants::COPY:
+                {
+                    // l_clbits followed by as many r_clbits
+                    std::size_t n_copied = inst.clbits.size() / 2;
+                    for (auto& branch : branches) {
+                        for (std::size_t i = 0; i < n_copied; ++i)
+                            branch.creg[inst.clbits[i]] = branch.creg[inst.clbits[n_copied + i]];
+                    }
+                    break;
+                }
+                case constants::CIF:
+                    for (auto& branch : branches) {
+                        if (branch.creg[inst.clbits[0]]) {
+                            for (const auto& sub_inst : circuit_.block(inst)) {
+                                if (!ops_.apply(branch.state, sub_inst))
+                                    return std::nullopt;
+                            }
+                        }
+                    }
+                    break;
+                default:
+                    for (auto& branch : branches) {
+                        if (!ops_.apply(branch.state, inst))
+                            return std::nullopt;
+                    }
+            }
+        }
+
+        return sample_counts_(branches, shots, rng);
+    }
+
+private:
+    // Outcomes less likely than this are dropped, as no shot would ever see them
+    static constexpr double MIN_PROBABILITY = 1e-12;
+
+    struct Branch {
+        State state;
+        double weight;
+        std::vector<bool> creg;
+    };
+
+    const CompiledCircuit& circuit_;
+    std::size_t n_clbits_;
+    Ops& ops_;
+    std::size_t max_branches_;
+
+    bool is_local_(const Instruction& inst) const
+    {
+        switch (inst.type) {
+            case constants::MEASURE:
+            case constants::COPY:
+            case constants::CIF:
+            case constants::SEND:
+            case constants::RECV:
+            case constants::QSEND:
+            case constants::QRECV:
+            case constants::EXPOSE:
+            case constants::RCONTROL:
+                return false;
+            default:
+                return std::find(inst.qubits.begin(), inst.qubits.end(), -1) == inst.qubits.end();
+        }
+    }
+
+    bool measure_(std::vector<Branch>& branches, const int qubit, const int clbit)
+    {
+        const std::size_t n_branches = branches.size();
+        for (std::size_t i = 0; i < n_branches; ++i) {
+            double p1 = std::clamp(ops_.probability_one(branches[i].state, qubit), 0.0, 1.0);
+            if (p1 < MIN_PROBABILITY) {
+                branches[i].creg[clbit] = false;
+                continue;
+            }
+            if (1.0 - p1 < MIN_PROBABILITY) {
+                branches[i].creg[clbit] = true;
+                continue;
+            }
+
+            if (branches.size() == max_branches_)
+                return false;
+
+            // Index access, the push_back may move the branches
+            Branch one{ops_.clone(branches[i].state), branches[i].weight * p1, branches[i].creg};
+            one.creg[clbit] = true;
+            ops_.collapse(one.state, qubit, 1, p1);
+            branches.push_back(std::move(one));
+
+            branches[i].weight *= 1.0 - p1;
+            branches[i].creg[clbit] = false;
+            ops_.collapse(branches[i].state, qubit, 0, 1.0 - p1);
+        }
+        return true;
+    }
+
+    // Multinomial sample of the shots over the branches, one binomial draw per branch
+    std::map<std::string, std::size_t> sample_counts_(const std::vector<Branch>& branches, std::size_t shots, std::mt19937_64& rng) const
+    {
+        std::map<std::string, std::size_t> counts;
+        double remaining_weight = 0.0;
+        for (const auto& branch : branches)
+            remaining_weight += branch.weight;
+
+        for (const auto& branch : branches) {
+            if (shots == 0)
+                break;
+            std::size_t branch_shots = shots;
+            if (branch.weight < remaining_weight) {
+                std::binomial_distribution<std::size_t> binomial(shots, std::clamp(branch.weight / remaining_weight, 0.0, 1.0));
+                branch_shots = binomial(rng);
+            }
+            remaining_weight -= branch.weight;
+            shots -= branch_shots;
+            if (branch_shots == 0)
+                continue;
+
+            std::string bits(n_clbits_, '0');
+            for (std::size_t i = 0; i < n_clbits_; ++i)
+                bits[n_clbits_ - i - 1] = branch.creg[i] ? '1' : '0';
+            counts[bits] += branch_shots;
+        }
+        return counts;
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "backends/simulators/classical_register.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Counts of the shots by their classical register, in an open addressing hash table keyed by 
+// the packed bits. Each thread keeps its own and they are merged at the end, so the bit strings
+// are only formatted once, for the result.
+class ShotCounts {
+public:
+    void add(const ClassicalRegister& creg, const std::size_t count = 1)
+    {
+        if (counts_.empty())
+            init_(creg.size());
+        add_(creg.words().data(), count);
+    }
+
+    void merge(const ShotCounts& other)
+    {
+        if (other.size_ == 0)
+            return;
+        if (counts_.empty())
+            init_(other.n_clbits_);
+        for (std::size_t slot = 0; slot < other.counts_.size(); ++slot) {
+            if (other.counts_[slot])
+                add_(other.key_(slot), other.counts_[slot]);
+        }
+    }
+
+    // Bit strings with clbit 0 as the rightmost character
+    std::map<std::string, std::size_t> to_map() const
+    {
+        std::map<std::string, std::size_t> counts;
+        for (std::size_t slot = 0; slot < counts_.size(); ++slot) {
+            if (!counts_[slot])
+                continue;
+            const std::uint64_t* key = key_(slot);
+            std::string bits(n_clbits_, '0');
+            for (std::size_t i = 0; i < n_clbits_; ++i) {
+                if ((key[i / 64] >> (i % 64)) & 1)
+                    bits[n_clbits_ - i - 1] = '1';
+            }
+            counts[std::move(bits)] = counts_[slot];
+        }
+        return counts;
+    }
+
+private:
+    static constexpr std::size_t INITIAL_SLOTS = 64;
+
+    std::size_t n_clbits_ = 0;
+    std::size_t n_words_ = 1;
+    std::vector<std::uint64_t> keys_;  // n_words_ per slot
+    std::vector<std::size_t> counts_;  // 0 for the empty slots
+    std::size_t size_ = 0;
+
+    void init_(const std::size_t n_clbits)
+    {
+        n_clbits_ = n_clbits;
+        n_words_ = std::max<std::size_t>(1, (n_clbits + 63) / 64);
+        keys_.assign(INITIAL_SLOTS * n_words_, 0);
+        counts_.assign(INITIAL_SLOTS, 0);
+    }
+
+    const std::uint64_t* key_(const std::size_t slot) const { return keys_.data() + slot * n_words_; }
+
+    std::size_t hash_(const std::uint64_t* key) const
+    {
+        std::uint64_t h = 0x9E3779B97F4A7C15ULL;
+        for (std::size_t i = 0; i < n_words_; ++i) {
+            h ^= key[i];
+            h *= 0xBF58476D1CE4E5B9ULL;
+            h ^= h >> 31;
+        }
+        return static_cast<std::size_t>(h);
+    }
+
+    // Registers of no clbits have no words, they all go to the zero key
+    void add_(const std::uint64_t* key, const std::size_t count)
+    {
+        static constexpr std::uint64_t ZERO_KEY[1] = {0};
+        if (n_clbits_ == 0)
+            key = ZERO_KEY;
+
+        const std::size_t mask = counts_.size() - 1;
+        std::size_t slot = hash_(key) & mask;
+        while (counts_[slot] && !std::equal(key, key + n_words_, key_(slot)))
+            slot = (slot + 1) & mask;
+
+        if (counts_[slot]) {
+            counts_[slot] += count;
+            return;
+        }
+        std::copy(key, key + n_words_, keys_.begin() + slot * n_words_);
+        counts_[slot] = count;
+        if (++size_ * 2 > counts_.size())
+            grow_();
+    }
+
+    void grow_()
+    {
+        std::vector<std::uint64_t> keys(keys_.size() * 2, 0);
+        std::vector<std::size_t> counts(counts_.size() * 2, 0);
+        keys.swap(keys_);
+        counts.swap(counts_);
+        size_ = 0;
+        for (std::size_t slot = 0; slot < counts.size(); ++slot) {
+            if (counts[slot])
+                add_(keys.data() + slot * n_words_, counts[slot]);
+        }
+    }
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+namespace cunqa {
+namespace sim {
+
+// First error of the shots run by an OpenMP team. An exception must not leave the parallel
+// region, so each thread captures it here, the remaining shots are skipped and it is thrown
+// again once the team is done.
+class ShotErrors {
+public:
+    void capture(std::exception_ptr error = std::current_exception())
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_)
+            error_ = error;
+        failed_ = true;
+    }
+
+    bool failed() const { return failed_; }
+
+    void rethrow() const
+    {
+        if (error_)
+            std::rethrow_exception(error_);
+    }
+
+private:
+    std::exception_ptr error_;
+    std::atomic<bool> failed_{false};
+    std::mutex mutex_;
+};
+
+} // End of sim namespace
+} // End of cunqa namespace
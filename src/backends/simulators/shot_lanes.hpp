@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+#include "classical_channel/classical_channel.hpp"
+#include "classical_channel/lane_channel.hpp"
+#include "backends/simulators/shot_counts.hpp"
+
+namespace cunqa {
+namespace sim {
+
+// Runs the shots of a circuit with classical communications in `n_lanes` threads, each with its
+// own simulator state, so that every message to another QPU carries a measurement of each lane.
+// `run_shots(lane, lane_shots)` simulates `lane_shots` shots talking through `lane` and returns
+// their counts.
+template <typename RunShots>
+ShotCounts run_shot_lanes(
+    comm::ClassicalChannel& classical_channel,
+    std::size_t n_lanes,
+    const std::size_t shots,
+    RunShots run_shots
+)
+{
+    n_lanes = std::min(n_lanes, shots);
+    comm::LaneChannel lanes(classical_channel, n_lanes);
+    std::vector<ShotCounts> lane_counts(n_lanes);
+    std::vector<std::exception_ptr> errors(n_lanes);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < n_lanes; ++i) {
+        threads.emplace_back([&, i]() {
+            auto lane = lanes.lane(i);
+            try {
+                // Shot j runs in lane j % n_lanes at both ends
+                lane_counts[i] = run_shots(lane, shots / n_lanes + (i < shots % n_lanes ? 1 : 0));
+            } catch (...) {
+                errors[i] = std::current_exception();
+            }
+            lanes.retire(i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (const auto& error : errors) {
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    ShotCounts counts;
+    for (const auto& lane_count : lane_counts)
+        counts.merge(lane_count);
+    return counts;
+}
+
+} // End of sim namespace
+} // End of cunqa namespace
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#ifdef OPENMP_IN_QC
+#include <omp.h>
+#endif
+
+namespace cunqa {
+namespace sim {
+
+// Tasks the QPU runs at the same time, set once before it starts. Each of them simulates its
+// shots with an OpenMP team of its own, so the cores are shared out among them.
+inline std::size_t concurrent_tasks = 1;
+
+#ifdef OPENMP_IN_QC
+// Threads of the team that simulates the shots of a task
+inline int shot_threads()
+{
+    return std::max(1, omp_get_max_threads() / static_cast<int>(std::max<std::size_t>(concurrent_tasks, 1)));
+}
+#endif
+
+} // End of sim namespace
+} // End of cunqa namespace
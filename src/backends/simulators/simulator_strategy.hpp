@@ -1,5 +1,8 @@
 #pragma once
 
+#include <optional>
+#include <vector>
+
 #include "quantum_task.hpp"
 #include "utils/json.hpp"
 
@@ -13,7 +16,12 @@ public:
     virtual ~SimulatorStrategy() {};
 
     virtual inline std::string get_name() const = 0;
+    // Called once the backend that owns the simulator is built, to prepare what all its 
+    // executions share
+    virtual void prepare(const T&) { }
     virtual JSON execute(const T& backend, const QuantumTask& circuit) = 0;
+    virtual std::optional<JSON> execute_batch(const T&, const QuantumTask&) { return std::nullopt; }
+    virtual std::optional<std::vector<JSON>> execute_many(const T&, const std::vector<QuantumTask>&) { return std::nullopt; }
 };
 
 } // End of sim namespace
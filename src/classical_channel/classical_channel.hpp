@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <utility>
 
 #include <utils/json.hpp>
 
@@ -23,6 +24,17 @@ public:
 
     void send_measure(const int& measurement, const std::string& target);
     int recv_measure(const std::string& origin);
+
+    // Measurements of several shots in a single message, one bit each
+    void send_measures(const std::vector<bool>& measurements, const std::string& target);
+    std::vector<bool> recv_measures(const std::string& origin, const std::size_t n_measurements);
+
+    // Next message of whichever QPU sends first, with the id of that QPU
+    std::pair<std::string, std::string> recv_any_info();
+    std::pair<std::string, std::vector<bool>> recv_any_measures(const std::size_t n_measurements);
+
+    // Whether a thread may send while another one is receiving
+    bool concurrent() const;
     
 private:
     struct Impl;
@@ -1,4 +1,6 @@
 #include <string>
+#include <utility>
+#include <vector>
 #include <mpi.h>
 
 #include "utils/helpers/net_functions.hpp"
@@ -14,14 +16,20 @@ struct ClassicalChannel::Impl
 {
     int mpi_size;
     int mpi_rank;
+    bool thread_multiple;
 
     Impl()
     {
-        MPI_Init(NULL, NULL);
+        // Shots run in parallel send from one thread while another one waits in MPI_Recv
+        int provided;
+        MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided);
+        thread_multiple = provided >= MPI_THREAD_MULTIPLE;
         MPI_Comm_size(MPI_COMM_WORLD, &(mpi_size));
         MPI_Comm_rank(MPI_COMM_WORLD, &(mpi_rank));
     
         LOGGER_DEBUG("Communication channel with MPI configured.");
+        if (!thread_multiple)
+            LOGGER_DEBUG("MPI without MPI_THREAD_MULTIPLE, shots communicating with other QPUs run one at a time.");
     }
 
     ~Impl() = default;
@@ -41,6 +49,20 @@ struct ClassicalChannel::Impl
         return measurement;
     }
 
+    void send_bytes(const std::vector<unsigned char>& data, const std::string& target)
+    {
+        int target_int = std::atoi(target.c_str());
+        MPI_Send(data.data(), data.size(), MPI_UNSIGNED_CHAR, target_int, 1, MPI_COMM_WORLD);
+    }
+
+    std::vector<unsigned char> recv_bytes(const std::size_t size, const std::string& origin)
+    {
+        std::vector<unsigned char> data(size);
+        int origin_int = std::atoi(origin.c_str());
+        MPI_Recv(data.data(), size, MPI_UNSIGNED_CHAR, origin_int, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        return data;
+    }
+
     void send_str(const std::string& data, const std::string& target)
     {
         int target_int = std::atoi(target.c_str());
@@ -49,6 +71,14 @@ struct ClassicalChannel::Impl
         MPI_Send(&data, size, MPI_CHAR, target_int, 1, MPI_COMM_WORLD);
     }
 
+    // Rank of the next message to arrive, from any other process
+    std::string probe_any()
+    {
+        MPI_Status status;
+        MPI_Probe(MPI_ANY_SOURCE, 1, MPI_COMM_WORLD, &status);
+        return std::to_string(status.MPI_SOURCE);
+    }
+
     std::string recv_str(const std::string& origin)
     {
         int datasize;
@@ -105,5 +135,43 @@ int ClassicalChannel::recv_measure(const std::string& origin)
     return pimpl_->recv(origin);
 }
 
+void ClassicalChannel::send_measures(const std::vector<bool>& measurements, const std::string& target)
+{
+    std::vector<unsigned char> packed((measurements.size() + 7) / 8, 0);
+    for (std::size_t i = 0; i < measurements.size(); ++i) {
+        if (measurements[i])
+            packed[i / 8] |= 1 << (i % 8);
+    }
+    pimpl_->send_bytes(packed, target);
+}
+
+std::vector<bool> ClassicalChannel::recv_measures(const std::string& origin, const std::size_t n_measurements)
+{
+    auto packed = pimpl_->recv_bytes((n_measurements + 7) / 8, origin);
+    std::vector<bool> measurements(n_measurements);
+    for (std::size_t i = 0; i < n_measurements; ++i)
+        measurements[i] = (packed[i / 8] >> (i % 8)) & 1;
+    return measurements;
+}
+
+std::pair<std::string, std::string> ClassicalChannel::recv_any_info()
+{
+    auto origin = pimpl_->probe_any();
+    auto data = pimpl_->recv_str(origin);
+    return {std::move(origin), std::move(data)};
+}
+
+std::pair<std::string, std::vector<bool>> ClassicalChannel::recv_any_measures(const std::size_t n_measurements)
+{
+    auto origin = pimpl_->probe_any();
+    auto measurements = recv_measures(origin, n_measurements);
+    return {std::move(origin), std::move(measurements)};
+}
+
+bool ClassicalChannel::concurrent() const
+{
+    return pimpl_->thread_multiple;
+}
+
 } // End of comm namespace
 } // End of cunqa namespace
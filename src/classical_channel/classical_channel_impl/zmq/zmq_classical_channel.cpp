@@ -4,6 +4,8 @@
 #include <memory>
 #include <algorithm>
 #include <unordered_map>
+#include <vector>
+#include <stdexcept>
 #include "zmq.hpp"
 
 #include "classical_channel/classical_channel.hpp"
@@ -15,6 +17,32 @@
 namespace cunqa {
 namespace comm {
 
+namespace {
+
+std::string pack_measures(const std::vector<bool>& measurements)
+{
+    std::string packed((measurements.size() + 7) / 8, '\0');
+    for (std::size_t i = 0; i < measurements.size(); ++i) {
+        if (measurements[i])
+            packed[i / 8] |= static_cast<char>(1 << (i % 8));
+    }
+    return packed;
+}
+
+std::vector<bool> unpack_measures(const std::string& packed, const std::size_t n_measurements)
+{
+    if (packed.size() != (n_measurements + 7) / 8) {
+        LOGGER_ERROR("Expected {} packed measurements, got {} bytes.", n_measurements, packed.size());
+        throw std::runtime_error("Packed measurements of a different size than expected.");
+    }
+    std::vector<bool> measurements(n_measurements);
+    for (std::size_t i = 0; i < n_measurements; ++i)
+        measurements[i] = (packed[i / 8] >> (i % 8)) & 1;
+    return measurements;
+}
+
+} // End of anonymous namespace
+
 struct ClassicalChannel::Impl
 {
     std::string zmq_endpoint;
@@ -92,6 +120,23 @@ struct ClassicalChannel::Impl
             }
         }
     }
+
+    std::pair<std::string, std::string> recv_any()
+    {
+        for (auto& [id, queue] : message_queue) {
+            if (!queue.empty()) {
+                std::string stored_data = std::move(queue.front());
+                queue.pop();
+                return {id, std::move(stored_data)};
+            }
+        }
+
+        zmq::message_t id;
+        zmq::message_t message;
+        [[maybe_unused]] auto ret1 = zmq_comm_server.recv(id, zmq::recv_flags::none);
+        [[maybe_unused]] auto ret2 = zmq_comm_server.recv(message, zmq::recv_flags::none);
+        return {std::string(static_cast<char*>(id.data()), id.size()), std::string(static_cast<char*>(message.data()), message.size())};
+    }
 };
 
 ClassicalChannel::ClassicalChannel(const std::string& qpu_id) : 
@@ -137,6 +182,27 @@ std::string ClassicalChannel::recv_info(const std::string& origin) { return pimp
 void ClassicalChannel::send_measure(const int& measurement, const std::string& target) { pimpl_->send(std::to_string(measurement), target); }
 int ClassicalChannel::recv_measure(const std::string& origin) { return std::stoi(pimpl_->recv(origin)); }
 
+void ClassicalChannel::send_measures(const std::vector<bool>& measurements, const std::string& target) 
+{ 
+    pimpl_->send(pack_measures(measurements), target); 
+}
+
+std::vector<bool> ClassicalChannel::recv_measures(const std::string& origin, const std::size_t n_measurements) 
+{ 
+    return unpack_measures(pimpl_->recv(origin), n_measurements); 
+}
+
+std::pair<std::string, std::string> ClassicalChannel::recv_any_info() { return pimpl_->recv_any(); }
+
+std::pair<std::string, std::vector<bool>> ClassicalChannel::recv_any_measures(const std::size_t n_measurements)
+{
+    auto [origin, data] = pimpl_->recv_any();
+    return {std::move(origin), unpack_measures(data, n_measurements)};
+}
+
+// Sends go through a socket per target and receives through the server socket
+bool ClassicalChannel::concurrent() const { return true; }
+
 
 } // End of comm namespace
 } // End of cunqa namespace
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "classical_channel/classical_channel.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Classical communications of several shots run at the same time, one per lane, each in its own
+// thread. The i-th measurement every lane sends to a QPU travels in a single message with one bit
+// per lane, and lane j on one QPU receives what lane j on the other one sent. Hence the QPUs at
+// both ends must run the same number of lanes, and the lanes of a QPU the same circuit.
+class LaneChannel {
+public:
+    LaneChannel(ClassicalChannel& channel, const std::size_t n_lanes) :
+        channel_{channel},
+        n_lanes_{n_lanes},
+        lanes_(n_lanes)
+    { }
+
+    // The interface of ClassicalChannel the shots use, for one lane
+    class Lane {
+    public:
+        void send_measure(const int& measurement, const std::string& target) { channel_.send_(index_, measurement, target); }
+        int recv_measure(const std::string& origin) { return channel_.recv_(index_, origin); }
+
+        std::size_t index() const { return index_; }
+
+    private:
+        Lane(LaneChannel& channel, const std::size_t index) : channel_{channel}, index_{index} { }
+
+        LaneChannel& channel_;
+        std::size_t index_;
+
+        friend class LaneChannel;
+    };
+
+    Lane lane(const std::size_t index) { return Lane(*this, index); }
+
+    // The lane has no more shots to run, so the messages do not wait for it anymore
+    void retire(const std::size_t index)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lanes_[index].retired = true;
+        for (auto& [target, outgoing] : outgoing_)
+            flush_(target, outgoing);
+        cv_.notify_all();
+    }
+
+private:
+    struct LaneState {
+        std::unordered_map<std::string, std::size_t> sent;     // By target
+        std::unordered_map<std::string, std::size_t> received; // By origin
+        bool retired = false;
+    };
+
+    struct Outgoing {
+        std::size_t flushed = 0; // Messages already sent
+        std::deque<std::vector<bool>> pending;
+    };
+
+    ClassicalChannel& channel_;
+    std::size_t n_lanes_;
+    std::vector<LaneState> lanes_;
+    std::unordered_map<std::string, Outgoing> outgoing_;
+    std::unordered_map<std::string, std::vector<std::vector<bool>>> incoming_; // By origin
+    bool receiving_ = false; // A lane is waiting on the channel
+    std::mutex mutex_;
+    std::condition_variable cv_;
+
+    void send_(const std::size_t index, const int measurement, const std::string& target)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& outgoing = outgoing_[target];
+        std::size_t message = lanes_[index].sent[target]++;
+        while (outgoing.flushed + outgoing.pending.size() <= message)
+            outgoing.pending.emplace_back(n_lanes_, false);
+        outgoing.pending[message - outgoing.flushed][index] = measurement == 1;
+
+        if (flush_(target, outgoing))
+            cv_.notify_all();
+    }
+
+    int recv_(const std::size_t index, const std::string& origin)
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        auto& incoming = incoming_[origin];
+        std::size_t message = lanes_[index].received[origin]++;
+
+        while (incoming.size() <= message) {
+            // What the other QPU is waiting for before answering may be in the pending messages
+            if (receiving_ || !flushed_(index)) {
+                cv_.wait(lock);
+                continue;
+            }
+
+            // Whatever QPU the message comes from, so that no lane waits behind another origin
+            receiving_ = true;
+            lock.unlock();
+            std::pair<std::string, std::vector<bool>> measurements;
+            try {
+                measurements = channel_.recv_any_measures(n_lanes_);
+            } catch (...) {
+                lock.lock();
+                receiving_ = false;
+                cv_.notify_all();
+                throw;
+            }
+            lock.lock();
+            receiving_ = false;
+            incoming_[measurements.first].push_back(std::move(measurements.second));
+            cv_.notify_all();
+        }
+        return incoming[message][index];
+    }
+
+    // Sends the messages every lane still running has contributed to
+    bool flush_(const std::string& target, Outgoing& outgoing)
+    {
+        bool flushed = false;
+        while (!outgoing.pending.empty()) {
+            for (const auto& lane : lanes_) {
+                if (!lane.retired && (!lane.sent.contains(target) || lane.sent.at(target) <= outgoing.flushed))
+                    return flushed;
+            }
+            channel_.send_measures(outgoing.pending.front(), target);
+            outgoing.pending.pop_front();
+            ++outgoing.flushed;
+            flushed = true;
+        }
+        return flushed;
+    }
+
+    bool flushed_(const std::size_t index) const
+    {
+        for (const auto& [target, sent] : lanes_[index].sent) {
+            if (outgoing_.at(target).flushed < sent)
+                return false;
+        }
+        return true;
+    }
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
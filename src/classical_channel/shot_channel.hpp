@@ -0,0 +1,97 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <utility>
+#include <unordered_map>
+
+#include "classical_channel/classical_channel.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Classical communications of shots run in parallel, in whatever order the threads pick them.
+// Each message carries the shot it belongs to, so shot i of one QPU always pairs with shot i of
+// the other. A single thread at a time takes the messages of any QPU as they arrive, and those
+// of other shots wait in a mailbox until their shot asks.
+class ShotChannel {
+public:
+    explicit ShotChannel(ClassicalChannel& channel) : channel_{channel} { }
+
+    // The interface of ClassicalChannel the shots use, for one shot
+    class Shot {
+    public:
+        void send_measure(const int& measurement, const std::string& target) { channel_.send_(index_, measurement, target); }
+        int recv_measure(const std::string& origin) { return channel_.recv_(index_, origin); }
+
+    private:
+        Shot(ShotChannel& channel, const std::size_t index) : channel_{channel}, index_{index} { }
+
+        ShotChannel& channel_;
+        std::size_t index_;
+
+        friend class ShotChannel;
+    };
+
+    Shot shot(const std::size_t index) { return Shot(*this, index); }
+
+private:
+    ClassicalChannel& channel_;
+    std::unordered_map<std::string, std::unordered_map<std::size_t, std::queue<int>>> mailbox_; // By origin and shot
+    bool receiving_ = false; // A shot is waiting on the channel
+    std::mutex send_mutex_;
+    std::mutex recv_mutex_;
+    std::condition_variable cv_;
+
+    void send_(const std::size_t index, const int measurement, const std::string& target)
+    {
+        std::lock_guard<std::mutex> lock(send_mutex_);
+        channel_.send_info(std::to_string(index) + ":" + std::to_string(measurement), target);
+    }
+
+    int recv_(const std::size_t index, const std::string& origin)
+    {
+        std::unique_lock<std::mutex> lock(recv_mutex_);
+        auto& shots = mailbox_[origin];
+
+        while (!shots.contains(index)) {
+            if (receiving_) {
+                cv_.wait(lock);
+                continue;
+            }
+
+            // Whatever QPU the message comes from, so that no shot waits behind another origin
+            receiving_ = true;
+            lock.unlock();
+            std::pair<std::string, std::string> message;
+            try {
+                message = channel_.recv_any_info();
+            } catch (...) {
+                lock.lock();
+                receiving_ = false;
+                cv_.notify_all();
+                throw;
+            }
+            lock.lock();
+            receiving_ = false;
+
+            char* measurement;
+            std::size_t shot = std::strtoull(message.second.c_str(), &measurement, 10);
+            mailbox_[message.first][shot].push(std::atoi(measurement + 1));
+            cv_.notify_all();
+        }
+
+        auto& measurements = shots.at(index);
+        int measurement = measurements.front();
+        measurements.pop();
+        if (measurements.empty())
+            shots.erase(index);
+        return measurement;
+    }
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
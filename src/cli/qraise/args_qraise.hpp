@@ -12,6 +12,13 @@ struct CunqaArgs : public argparse::Args
     int& n_qpus                                         = kwarg("n,num_qpus", "Number of QPUs to be raised.").set_default(0);
     std::string& time                                   = kwarg("t,time", "Time for the QPUs to be raised.").set_default("");
     int& cores_per_qpu                                  = kwarg("c,cores", "Number of cores per QPU.").set_default(2);
+    std::optional<int>& workers                         = kwarg("w,workers", "Number of tasks each QPU executes concurrently (no communications only).");
+    std::optional<int>& max_queued_jobs                 = kwarg("max-queued-jobs", "Maximum number of tasks waiting in each QPU before it answers busy.");
+    std::optional<int>& max_queued_mb                   = kwarg("max-queued-mb", "Maximum size in MB of the tasks waiting in each QPU before it answers busy.");
+    std::optional<int>& result_cache_entries            = kwarg("result-cache-entries", "Number of results of seeded tasks each QPU keeps to answer repeated tasks.");
+    std::optional<int>& result_cache_mb                 = kwarg("result-cache-mb", "Maximum size in MB of the results each QPU keeps.");
+    std::optional<int>& coalesce_jobs                   = kwarg("coalesce-jobs", "Maximum number of queued tasks each Aer QPU simulates in a single execution.");
+    std::optional<int>& shot_lanes                      = kwarg("shot-lanes", "Number of shots each QPU with classical communications runs at the same time, sharing their messages.");
     std::optional<std::string>& partition               = kwarg("p,partition", "Partition requested for the QPUs.");
     std::optional<int>& mem_per_qpu                     = kwarg("mem,mem-per-qpu", "Memory given to each QPU in GB.").set_default(15);
     std::optional<std::size_t>& number_of_nodes         = kwarg("N,n_nodes", "Number of nodes.").set_default(1);
@@ -113,6 +113,7 @@ bool write_cc_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs& args)
     sbatchFile << "#SBATCH --output=qraise_%j\n\n";
     sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
     sbatchFile << "EPILOG_PATH=" << std::string(constants::CUNQA_PATH) << "/epilog.sh\n";
+    write_qpu_settings(sbatchFile, args);
 
     return true;
 }
@@ -157,6 +158,11 @@ void write_cc_sbatch(std::ofstream& sbatchFile, const CunqaArgs& args)
         LOGGER_ERROR("Simulator {} is not available for classical communications simulation. Aborting. ", std::string(args.simulator));
         throw std::runtime_error("Error.");
 
+    } else if (args.shot_lanes.has_value() && args.shot_lanes.value() > 1 && std::string(args.simulator) == "Munich") {
+        // Every QPU of the family must run the same lanes, and Munich sends its measurements one shot at a time
+        LOGGER_ERROR("Simulator Munich does not support shot lanes. Aborting. ");
+        throw std::runtime_error("Bad arguments.");
+
     } else if (exists_family_name(args.family_name, constants::QPUS_FILEPATH)) {
         LOGGER_ERROR("There are QPUs with the same family name as the provided: {}.", args.family_name.c_str());
         throw std::runtime_error("Bad family name.");
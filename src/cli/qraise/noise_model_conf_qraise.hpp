@@ -7,6 +7,7 @@
 #include "utils/constants.hpp"
 #include "logger.hpp"
 #include "args_qraise.hpp"
+#include "utils_qraise.hpp"
 
 
 namespace {
@@ -111,6 +112,7 @@ bool write_noise_model_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs&
     sbatchFile << "#SBATCH --output=qraise_%j\n\n";
     sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
     sbatchFile << "EPILOG_PATH=" << std::string(constants::CUNQA_PATH) << "/epilog.sh\n";
+    write_qpu_settings(sbatchFile, args);
 
     return true;
 }
@@ -111,6 +111,7 @@ bool write_simple_sbatch_header(std::ofstream& sbatchFile, const CunqaArgs& args
     sbatchFile << "#SBATCH --output=qraise_%j\n\n";
     sbatchFile << "unset SLURM_MEM_PER_CPU SLURM_CPU_BIND_LIST SLURM_CPU_BIND\n";
     sbatchFile << "EPILOG_PATH=" << std::string(constants::CUNQA_PATH) << "/epilog.sh\n";
+    write_qpu_settings(sbatchFile, args);
 
     return true;
 }
@@ -48,6 +48,25 @@ bool exists_family_name(const std::string& family, const std::string& info_path)
     }
 }
 
+// Settings read by setup_qpus from the environment of the job
+void write_qpu_settings(std::ofstream& sbatchFile, const CunqaArgs& args)
+{
+    if (args.workers.has_value())
+        sbatchFile << "export CUNQA_QPU_WORKERS=" << std::to_string(args.workers.value()) << "\n";
+    if (args.max_queued_jobs.has_value())
+        sbatchFile << "export CUNQA_QPU_MAX_QUEUED_JOBS=" << std::to_string(args.max_queued_jobs.value()) << "\n";
+    if (args.max_queued_mb.has_value())
+        sbatchFile << "export CUNQA_QPU_MAX_QUEUED_MB=" << std::to_string(args.max_queued_mb.value()) << "\n";
+    if (args.result_cache_entries.has_value())
+        sbatchFile << "export CUNQA_QPU_RESULT_CACHE_ENTRIES=" << std::to_string(args.result_cache_entries.value()) << "\n";
+    if (args.result_cache_mb.has_value())
+        sbatchFile << "export CUNQA_QPU_RESULT_CACHE_MB=" << std::to_string(args.result_cache_mb.value()) << "\n";
+    if (args.coalesce_jobs.has_value())
+        sbatchFile << "export CUNQA_QPU_COALESCE_JOBS=" << std::to_string(args.coalesce_jobs.value()) << "\n";
+    if (args.shot_lanes.has_value())
+        sbatchFile << "export CUNQA_QPU_SHOT_LANES=" << std::to_string(args.shot_lanes.value()) << "\n";
+}
+
 void remove_tmp_files(const std::string filepath = "")
 {
     if (!filepath.empty()) {
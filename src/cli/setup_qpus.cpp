@@ -1,9 +1,11 @@
 
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
+#include <type_traits>
 #include <fcntl.h>
 #include <sys/file.h>
 #include <unistd.h>
@@ -26,6 +28,7 @@
 #include "backends/simulators/Qulacs/qulacs_simple_simulator.hpp"
 #include "backends/simulators/Qulacs/qulacs_cc_simulator.hpp"
 #include "backends/simulators/Qulacs/qulacs_qc_simulator.hpp"
+#include "backends/simulators/shot_threads.hpp"
 
 #include "utils/constants.hpp"
 #include "utils/json.hpp"
@@ -72,7 +75,42 @@ void turn_ON_QPU(
     config.set_basis_gates(get_basis_gates(simulator->get_name()));
     if (!backend_json.empty())
         config = backend_json;
-    QPU qpu(std::make_unique<BackendType>(config, std::move(simulator)), mode, name, family);
+
+    // Classical and quantum communications share a single channel per QPU, so only 
+    // QPUs without communications can run several tasks at the same time
+    std::size_t n_workers = 1;
+    if constexpr (std::is_same_v<BackendType, SimpleBackend>) {
+        if (const char* workers = std::getenv("CUNQA_QPU_WORKERS"))
+            n_workers = std::max(1, std::atoi(workers));
+    }
+
+    std::size_t max_queued_jobs = QPU::DEFAULT_MAX_QUEUED_JOBS;
+    std::size_t max_queued_bytes = QPU::DEFAULT_MAX_QUEUED_BYTES;
+    if (const char* jobs = std::getenv("CUNQA_QPU_MAX_QUEUED_JOBS"))
+        max_queued_jobs = std::max(1, std::atoi(jobs));
+    if (const char* mb = std::getenv("CUNQA_QPU_MAX_QUEUED_MB"))
+        max_queued_bytes = std::max(1L, std::atol(mb)) * 1024 * 1024;
+
+    std::size_t result_cache_entries = 0;
+    std::size_t result_cache_bytes = QPU::DEFAULT_RESULT_CACHE_BYTES;
+    if (const char* entries = std::getenv("CUNQA_QPU_RESULT_CACHE_ENTRIES"))
+        result_cache_entries = std::max(0, std::atoi(entries));
+    if (const char* mb = std::getenv("CUNQA_QPU_RESULT_CACHE_MB"))
+        result_cache_bytes = std::max(1L, std::atol(mb)) * 1024 * 1024;
+
+    // Only Aer can run several independent circuits in a single execution
+    std::size_t max_coalesced_jobs = 1;
+    if constexpr (std::is_same_v<Simulator, AerSimpleSimulator>) {
+        if (const char* jobs = std::getenv("CUNQA_QPU_COALESCE_JOBS"))
+            max_coalesced_jobs = std::max(1, std::atoi(jobs));
+    }
+
+    // The workers share the cores for the shots of their tasks
+    sim::concurrent_tasks = n_workers;
+
+    QPU qpu(std::make_unique<BackendType>(config, std::move(simulator)), mode, name, family, 
+            n_workers, max_queued_jobs, max_queued_bytes, result_cache_entries, result_cache_bytes, 
+            max_coalesced_jobs);
     qpu.turn_ON();
 }
 
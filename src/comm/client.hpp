@@ -11,12 +11,14 @@ namespace comm {
 template <typename T>
 class FutureWrapper {
 public: 
-    FutureWrapper(T * client) : client_{client} {};
+    FutureWrapper(T * client, const std::string& job_id) : client_{client}, job_id_{job_id} {};
     
-    inline std::string get() { return client_->recv_results(); };
+    inline std::string get() { return client_->recv_results(job_id_); };
     inline bool valid() { return true; };
+    inline const std::string& job_id() const { return job_id_; };
 private:
     T * client_;
+    std::string job_id_;
 };
 
 class Client {
@@ -28,7 +30,12 @@ public:
     void connect(const std::string& endpoint);
     FutureWrapper<Client> send_circuit(const std::string& circuit);
     FutureWrapper<Client> send_parameters(const std::string& parameters);
-    std::string recv_results();
+    // Returns the result of the given job. Results of other jobs received in the 
+    // meantime are kept until their own future asks for them.
+    std::string recv_results(const std::string& job_id);
+    // Asks the server to drop the job. Its future still gets an answer: the result if it
+    // had already finished or a cancelled response otherwise.
+    void cancel(const std::string& job_id);
     void disconnect(const std::string& endpoint = "");
 
 private:
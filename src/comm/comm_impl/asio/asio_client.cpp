@@ -2,8 +2,12 @@
 #include <boost/asio.hpp>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 #include "comm/client.hpp"
+#include "comm/protocol.hpp"
+#include "comm/in_flight_jobs.hpp"
 #include "logger.hpp"
 #include "utils/helpers/net_functions.hpp"
 
@@ -50,32 +54,43 @@ struct Client::Impl {
         }
     }
 
-    void send(const std::string& data) 
+    std::string send(const std::string& data) 
     {
-        auto data_length = legacy_size_cast<uint32_t, std::size_t>(data.size());
-        auto data_length_network = htonl(data_length);
-
-        try {
-            as::write(socket_, as::buffer(&data_length_network, sizeof(data_length_network))); 
-            as::write(socket_, as::buffer(data));
-            LOGGER_DEBUG("Message sent.");
-        } catch (const boost::system::system_error& e) {
-            LOGGER_ERROR("Error sending the circuit.");
-        }
-        
+        std::string job_id = std::to_string(next_job_id_++);
+        in_flight_.add(job_id, data);
+        send_(job_id, data);
+        return job_id;
     }
 
-    std::string recv() 
+    void cancel(const std::string& job_id)
     {
-        try {
-            uint32_t result_length_network;
-            as::read(socket_, as::buffer(&result_length_network, sizeof(result_length_network)));
-            uint32_t result_length = ntohl(result_length_network);
+        // A busy answer of a cancelled job must not make it be sent again
+        in_flight_.cancel(job_id);
+        send_(job_id, CANCEL_MESSAGE);
+    }
 
-            std::string result(result_length, '\0');
-            as::read(socket_, as::buffer(&result[0], result_length));
-            LOGGER_DEBUG("Result received: {}", result);
+    std::string recv(const std::string& job_id) 
+    {
+        auto pending = pending_results_.find(job_id);
+        if (pending != pending_results_.end()) {
+            std::string result = std::move(pending->second);
+            pending_results_.erase(pending);
             return result;
+        }
+
+        try {
+            while (true) {
+                std::string reply_job_id = read_frame_();
+                std::string result = read_frame_();
+                LOGGER_DEBUG("Result received: {}", result);
+
+                if (!in_flight_.settle(reply_job_id, result, [&](const std::string& data) { send_(reply_job_id, data); }))
+                    continue;
+
+                if (reply_job_id == job_id)
+                    return result;
+                pending_results_.emplace(std::move(reply_job_id), std::move(result));
+            }
         } catch (const boost::system::system_error& e) {
             LOGGER_ERROR("Error receiving the circuit: {} (HINT: Check the circuit format and/or if QPUs are still up working.)", e.code().message());
         }
@@ -87,6 +102,44 @@ struct Client::Impl {
     {
         socket_.close(); // Only a unique server per client
         socket_ = tcp::socket(socket_.get_executor());
+        pending_results_.clear();
+        in_flight_.clear();
+    }
+
+private:
+    std::uint64_t next_job_id_ = 0;
+    std::unordered_map<std::string, std::string> pending_results_;
+    InFlightJobs in_flight_;
+
+    void send_(const std::string& job_id, const std::string& data)
+    {
+        try {
+            write_frame_(job_id);
+            write_frame_(data);
+            LOGGER_DEBUG("Message sent.");
+        } catch (const boost::system::system_error& e) {
+            LOGGER_ERROR("Error sending the circuit.");
+        }
+    }
+
+    void write_frame_(const std::string& data)
+    {
+        auto data_length = legacy_size_cast<uint32_t, std::size_t>(data.size());
+        auto data_length_network = htonl(data_length);
+
+        as::write(socket_, as::buffer(&data_length_network, sizeof(data_length_network))); 
+        as::write(socket_, as::buffer(data));
+    }
+
+    std::string read_frame_()
+    {
+        uint32_t data_length_network;
+        as::read(socket_, as::buffer(&data_length_network, sizeof(data_length_network)));
+        uint32_t data_length = ntohl(data_length_network);
+
+        std::string data(data_length, '\0');
+        as::read(socket_, as::buffer(&data[0], data_length));
+        return data;
     }
 };
 
@@ -102,18 +155,20 @@ void Client::connect(const std::string& endpoint) {
 
 FutureWrapper<Client> Client::send_circuit(const std::string& circuit) 
 { 
-    pimpl_->send(circuit);
-    return FutureWrapper<Client>(this); 
+    return FutureWrapper<Client>(this, pimpl_->send(circuit)); 
 }
 
 FutureWrapper<Client> Client::send_parameters(const std::string& parameters) 
 { 
-    pimpl_->send(parameters);
-    return FutureWrapper<Client>(this); 
+    return FutureWrapper<Client>(this, pimpl_->send(parameters)); 
+}
+
+std::string Client::recv_results(const std::string& job_id) {
+    return pimpl_->recv(job_id);
 }
 
-std::string Client::recv_results() {
-    return pimpl_->recv();
+void Client::cancel(const std::string& job_id) {
+    pimpl_->cancel(job_id);
 }
 
 void Client::disconnect(const std::string& endpoint) {
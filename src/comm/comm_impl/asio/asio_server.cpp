@@ -1,6 +1,18 @@
 #include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <queue>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "comm/server.hpp"
 #include "logger.hpp"
@@ -14,80 +26,270 @@ using as::ip::tcp;
 namespace cunqa {
 namespace comm {
 
+namespace {
+
+// Every connection reads and writes inside its own strand, so the handlers of a
+// connection never run concurrently while different connections use all io threads.
+class Connection : public std::enable_shared_from_this<Connection> {
+public:
+    using OnMessage = std::function<void(Message)>;
+    using OnClose = std::function<void(const std::string&)>;
+
+    Connection(tcp::socket socket, const std::string& id, OnMessage on_message, OnClose on_close) :
+        socket_{std::move(socket)},
+        id_{id},
+        on_message_{std::move(on_message)},
+        on_close_{std::move(on_close)}
+    { }
+
+    void start()
+    {
+        read_header_();
+    }
+
+    void deliver(const std::string& job_id, const std::string& result)
+    {
+        auto frames = std::make_shared<std::string>(frame_(job_id) + frame_(result));
+        as::post(socket_.get_executor(), [self = shared_from_this(), frames]() {
+            bool writing = !self->write_queue_.empty();
+            self->write_queue_.push_back(frames);
+            if (!writing)
+                self->write_();
+        });
+    }
+
+    void close()
+    {
+        as::post(socket_.get_executor(), [self = shared_from_this()]() { self->close_(); });
+    }
+
+private:
+    tcp::socket socket_;
+    std::string id_;
+    OnMessage on_message_;
+    OnClose on_close_;
+
+    uint32_t length_network_;
+    std::string job_id_;
+    std::string buffer_;
+    bool reading_job_id_ = true;
+    std::deque<std::shared_ptr<std::string>> write_queue_;
+
+    static std::string frame_(const std::string& data)
+    {
+        auto data_length = legacy_size_cast<uint32_t, std::size_t>(data.size());
+        auto data_length_network = htonl(data_length);
+
+        std::string frame(reinterpret_cast<const char*>(&data_length_network), sizeof(data_length_network));
+        return frame + data;
+    }
+
+    // Messages are [job id, payload], each of them prefixed with its length
+    void read_header_()
+    {
+        as::async_read(socket_, as::buffer(&length_network_, sizeof(length_network_)),
+            [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+                if (ec)
+                    return self->on_error_(ec);
+                self->buffer_.assign(ntohl(self->length_network_), '\0');
+                self->read_body_();
+            });
+    }
+
+    void read_body_()
+    {
+        as::async_read(socket_, as::buffer(buffer_),
+            [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+                if (ec)
+                    return self->on_error_(ec);
+
+                if (self->reading_job_id_) {
+                    self->job_id_ = std::move(self->buffer_);
+                } else {
+                    self->on_message_({self->id_, std::move(self->job_id_), std::move(self->buffer_)});
+                }
+                self->reading_job_id_ = !self->reading_job_id_;
+                self->read_header_();
+            });
+    }
+
+    void write_()
+    {
+        as::async_write(socket_, as::buffer(*write_queue_.front()),
+            [self = shared_from_this()](boost::system::error_code ec, std::size_t) {
+                if (ec) {
+                    LOGGER_ERROR("Error sending the result.");
+                    return self->close_();
+                }
+                self->write_queue_.pop_front();
+                if (!self->write_queue_.empty())
+                    self->write_();
+            });
+    }
+
+    void on_error_(const boost::system::error_code& ec)
+    {
+        if (ec == as::error::eof) {
+            // Client closed the connection cleanly
+            LOGGER_DEBUG("Client disconnected gracefully.");
+        } else if (ec == as::error::connection_reset) {
+            LOGGER_ERROR("Client connection reset (forcible close).");
+        } else if (ec != as::error::operation_aborted) {
+            LOGGER_ERROR("Error receiving the circuit: {}", ec.message());
+        }
+        close_();
+    }
+
+    void close_()
+    {
+        if (!socket_.is_open())
+            return;
+        boost::system::error_code ignored;
+        socket_.close(ignored);
+        on_close_(id_);
+    }
+};
+
+} // End of anonymous namespace
+
 struct Server::Impl {
     as::io_context io_context_;
+    as::executor_work_guard<as::io_context::executor_type> work_guard_;
     tcp::acceptor acceptor_;
-    tcp::socket socket_;
+    std::vector<std::thread> io_threads_;
+    std::atomic<bool> accepting_{false};
 
     std::string asio_endpoint;
 
+    std::mutex connections_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<Connection>> connections_;
+    std::size_t next_connection_id_ = 0;
+
+    std::queue<Message> messages_;
+    std::mutex messages_mutex_;
+    std::condition_variable messages_condition_;
+
     Impl(const std::string& ip) :
-        acceptor_{io_context_, tcp::endpoint{as::ip::address::from_string(ip), 0}},
-        socket_{acceptor_.get_executor()}
-    { 
+        work_guard_{as::make_work_guard(io_context_)},
+        acceptor_{io_context_, tcp::endpoint{as::ip::address::from_string(ip), 0}}
+    {
         auto ep = acceptor_.local_endpoint();
         auto port = ep.port();
-        asio_endpoint = ip + ":" + std::to_string(port);  
+        asio_endpoint = ip + ":" + std::to_string(port);
+
+        // Number of threads running the io_context, set through CUNQA_SERVER_IO_THREADS
+        std::size_t n_io_threads = 1;
+        if (const char* io_threads = std::getenv("CUNQA_SERVER_IO_THREADS"))
+            n_io_threads = std::max(1, std::atoi(io_threads));
+        for (std::size_t i = 0; i < n_io_threads; ++i)
+            io_threads_.emplace_back([this]() { io_context_.run(); });
+    }
+
+    ~Impl()
+    {
+        close();
     }
 
     void accept()
     {
-        acceptor_.accept(socket_);
-    }
-
-    std::string recv() 
-    {
-        try {
-            uint32_t data_length_network;
-            as::read(socket_, as::buffer(&data_length_network, sizeof(data_length_network)));
-            
-            uint32_t data_length = ntohl(data_length_network);
-            std::string data(data_length, '\0');
-            as::read(socket_, as::buffer(&data[0], data_length));
-            return data;
-        } catch (const boost::system::system_error& e) {
-            if (e.code() == boost::asio::error::eof) {
-                // Client closed the connection cleanly
-                LOGGER_DEBUG("Client disconnected gracefully.");
-                socket_.close(); 
-                return "CLOSE";
-            } else if (e.code() == boost::asio::error::connection_reset) {
-                LOGGER_ERROR("Client connection reset (forcible close).");
-                socket_.close(); 
-                return "CLOSE";
-            } else {
-                LOGGER_ERROR("Error receiving the circuit.");
-                throw;
-            }
+        // Connections are accepted asynchronously for the whole life of the server,
+        // so later calls (e.g. after a "CLOSE") have nothing to do
+        if (!accepting_.exchange(true))
+            as::post(io_context_, [this]() { this->accept_next_(); });
+    }
+
+    void accept_next_()
+    {
+        acceptor_.async_accept(as::make_strand(io_context_),
+            [this](boost::system::error_code ec, tcp::socket socket) {
+                if (ec) {
+                    if (ec != as::error::operation_aborted)
+                        LOGGER_ERROR("Error accepting a connection: {}", ec.message());
+                    return;
+                }
+
+                std::shared_ptr<Connection> connection;
+                {
+                    std::lock_guard<std::mutex> lock(connections_mutex_);
+                    std::string id = std::to_string(next_connection_id_++);
+                    connection = std::make_shared<Connection>(std::move(socket), id,
+                        [this](Message message) { this->push_message_(std::move(message)); },
+                        [this](const std::string& id) { this->remove_connection_(id); });
+                    connections_.emplace(id, connection);
+                }
+                LOGGER_DEBUG("New client connected.");
+                connection->start();
+                accept_next_();
+            });
+    }
+
+    void push_message_(Message message)
+    {
+        {
+            std::lock_guard<std::mutex> lock(messages_mutex_);
+            messages_.push(std::move(message));
         }
+        messages_condition_.notify_one();
+    }
 
-        return std::string();
+    void remove_connection_(const std::string& id)
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex_);
+        connections_.erase(id);
     }
 
-    void send(const std::string& result) 
+    Message recv()
     {
-        try {    
-            auto data_length = legacy_size_cast<uint32_t, std::size_t>(result.size());
-            auto data_length_network = htonl(data_length);
+        std::unique_lock<std::mutex> lock(messages_mutex_);
+        messages_condition_.wait(lock, [this] { return !messages_.empty(); });
+        Message message = std::move(messages_.front());
+        messages_.pop();
+        return message;
+    }
 
-            as::write(socket_, as::buffer(&data_length_network, sizeof(data_length_network))); 
-            as::write(socket_, as::buffer(result));
-        } catch (const boost::system::system_error& e) {
+    void send(const std::string& result, const std::string& client_id, const std::string& job_id)
+    {
+        std::shared_ptr<Connection> connection;
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            auto it = connections_.find(client_id);
+            if (it != connections_.end())
+                connection = it->second;
+        }
+
+        if (!connection) {
             LOGGER_ERROR("Error sending the result.");
-            throw;
+            throw std::runtime_error("Client " + client_id + " is not connected anymore.");
         }
+        connection->deliver(job_id, result);
     }
 
     void close()
     {
-        this->socket_.close();
+        if (io_threads_.empty())
+            return;
+
+        as::post(io_context_, [this]() {
+            boost::system::error_code ignored;
+            acceptor_.close(ignored);
+        });
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex_);
+            for (auto& [id, connection] : connections_)
+                connection->close();
+        }
+        work_guard_.reset();
+        io_context_.stop();
+        for (auto& io_thread : io_threads_)
+            io_thread.join();
+        io_threads_.clear();
     }
 };
 
 Server::Server(const std::string& mode) :
     mode{mode},
     nodename{get_nodename()},
-    gpu{get_associated_gpu()},
+    device(get_device()),
     pimpl_{std::make_unique<Impl>(mode == "hpc" ? "127.0.0.1" : get_IP_address())}
 { 
     endpoint = pimpl_->asio_endpoint;
@@ -100,15 +302,15 @@ void Server::accept()
     pimpl_->accept();
 }
 
-std::string Server::recv_data() 
+Message Server::recv_data() 
 { 
     return pimpl_->recv();
 }
 
-void Server::send_result(const std::string& result) 
+void Server::send_result(const std::string& result, const std::string& client_id, const std::string& job_id) 
 { 
     try {
-        pimpl_->send(result);
+        pimpl_->send(result, client_id, job_id);
     } catch (const std::exception& e) {
         throw ServerException(e.what());
     }
@@ -1,8 +1,12 @@
 #include "zmq.hpp"
 #include <iostream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 
 #include "comm/client.hpp"
+#include "comm/protocol.hpp"
+#include "comm/in_flight_jobs.hpp"
 #include "logger.hpp"
 
 
@@ -32,23 +36,47 @@ struct Client::Impl {
         }
     }
 
-    void send(const std::string& data) 
+    std::string send(const std::string& data) 
     {
-        try {
-            zmq::message_t message(data.begin(), data.end());
-            socket_.send(message, zmq::send_flags::none);
-        } catch (const zmq::error_t& e) {
-            LOGGER_ERROR("Error sending the circuit: {}", e.what());
-        }
+        std::string job_id = std::to_string(next_job_id_++);
+        in_flight_.add(job_id, data);
+        send_(job_id, data);
+        return job_id;
     }
 
-    std::string recv() 
+    void cancel(const std::string& job_id)
     {
-        try {
-            zmq::message_t reply;
-            auto size = socket_.recv(reply, zmq::recv_flags::none);
-            std::string result(static_cast<char*>(reply.data()), size.value());
+        // A busy answer of a cancelled job must not make it be sent again
+        in_flight_.cancel(job_id);
+        send_(job_id, CANCEL_MESSAGE);
+    }
+
+    std::string recv(const std::string& job_id) 
+    {
+        auto pending = pending_results_.find(job_id);
+        if (pending != pending_results_.end()) {
+            std::string result = std::move(pending->second);
+            pending_results_.erase(pending);
             return result;
+        }
+
+        try {
+            while (true) {
+                zmq::message_t reply_id;
+                auto id_size = socket_.recv(reply_id, zmq::recv_flags::none);
+                std::string reply_job_id(static_cast<char*>(reply_id.data()), id_size.value());
+
+                zmq::message_t reply;
+                auto size = socket_.recv(reply, zmq::recv_flags::none);
+                std::string result(static_cast<char*>(reply.data()), size.value());
+
+                if (!in_flight_.settle(reply_job_id, result, [&](const std::string& data) { send_(reply_job_id, data); }))
+                    continue;
+
+                if (reply_job_id == job_id)
+                    return result;
+                pending_results_.emplace(std::move(reply_job_id), std::move(result));
+            }
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Error receiving the circuit: {}", e.what());
         }
@@ -63,11 +91,28 @@ struct Client::Impl {
         } else {
             socket_.close();
             socket_ = zmq::socket_t(context_, zmq::socket_type::dealer);
+            pending_results_.clear();
+            in_flight_.clear();
         }
     }
 
     zmq::context_t context_;
     zmq::socket_t socket_;
+    std::uint64_t next_job_id_ = 0;
+    std::unordered_map<std::string, std::string> pending_results_;
+    InFlightJobs in_flight_;
+
+    void send_(const std::string& job_id, const std::string& data)
+    {
+        try {
+            zmq::message_t job_id_frame(job_id.begin(), job_id.end());
+            zmq::message_t message(data.begin(), data.end());
+            socket_.send(job_id_frame, zmq::send_flags::sndmore);
+            socket_.send(message, zmq::send_flags::none);
+        } catch (const zmq::error_t& e) {
+            LOGGER_ERROR("Error sending the circuit: {}", e.what());
+        }
+    }
 };
 
 
@@ -83,18 +128,20 @@ void Client::connect(const std::string& endpoint) {
 
 FutureWrapper<Client> Client::send_circuit(const std::string& circuit) 
 { 
-    pimpl_->send(circuit);
-    return FutureWrapper<Client>(this); 
+    return FutureWrapper<Client>(this, pimpl_->send(circuit)); 
 }
 
 FutureWrapper<Client> Client::send_parameters(const std::string& parameters) 
 { 
-    pimpl_->send(parameters);
-    return FutureWrapper<Client>(this); 
+    return FutureWrapper<Client>(this, pimpl_->send(parameters)); 
+}
+
+std::string Client::recv_results(const std::string& job_id) {
+    return pimpl_->recv(job_id);
 }
 
-std::string Client::recv_results() {
-    return pimpl_->recv();
+void Client::cancel(const std::string& job_id) {
+    pimpl_->cancel(job_id);
 }
 
 void Client::disconnect(const std::string& endpoint) {
@@ -1,4 +1,11 @@
 #include "zmq.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "comm/server.hpp"
 #include "logger.hpp"
@@ -7,65 +14,161 @@
 namespace cunqa {
 namespace comm {
 
+namespace {
+
+std::vector<zmq::message_t> recv_frames(zmq::socket_t& socket)
+{
+    std::vector<zmq::message_t> frames;
+    do {
+        frames.emplace_back();
+        if (!socket.recv(frames.back(), zmq::recv_flags::none))
+            break;
+    } while (frames.back().more());
+
+    return frames;
+}
+
+void send_frames(zmq::socket_t& socket, std::vector<zmq::message_t>& frames)
+{
+    for (std::size_t i = 0; i < frames.size(); ++i)
+        socket.send(frames[i], i + 1 < frames.size() ? zmq::send_flags::sndmore : zmq::send_flags::none);
+}
+
+std::string to_string(const zmq::message_t& frame)
+{
+    return std::string(static_cast<const char*>(frame.data()), frame.size());
+}
+
+} // End of anonymous namespace
+
+// The ROUTER socket is only touched by the I/O thread. Incoming requests are forwarded
+// to recv() through an inproc PAIR and results come back from the compute threads
+// through an inproc PUSH/PULL queue, each compute thread with its own PUSH socket.
 struct Server::Impl {
     zmq::context_t context_;
-    zmq::socket_t socket_;
-    std::queue<std::string> rid_queue_;
+    zmq::socket_t router_;
+    zmq::socket_t requests_out_;  // I/O thread side of the PAIR
+    zmq::socket_t requests_in_;   // recv() side of the PAIR
+    zmq::socket_t results_in_;    // I/O thread side of the PUSH/PULL
 
     std::string zmq_endpoint;
+    std::string requests_endpoint_;
+    std::string results_endpoint_;
+
+    std::mutex push_sockets_mutex_;
+    std::vector<std::unique_ptr<zmq::socket_t>> push_sockets_;
+    std::size_t instance_id_;
+
+    std::thread io_thread_;
 
     Impl(const std::string& mode) :
-        socket_{context_, zmq::socket_type::router}
+        router_{context_, zmq::socket_type::router},
+        requests_out_{context_, zmq::socket_type::pair},
+        requests_in_{context_, zmq::socket_type::pair},
+        results_in_{context_, zmq::socket_type::pull}
     {
+        static std::atomic<std::size_t> instances{0};
+        instance_id_ = instances++;
+        requests_endpoint_ = "inproc://cunqa-server-requests-" + std::to_string(instance_id_);
+        results_endpoint_ = "inproc://cunqa-server-results-" + std::to_string(instance_id_);
+
         try {
             std::string ip = (mode == "hpc" ? "127.0.0.1"s : get_IP_address());
-            socket_.bind("tcp://" + ip + ":*");
-            
+            router_.bind("tcp://" + ip + ":*");
+
             char endpoint[256];
             size_t sz = sizeof(endpoint);
-            zmq_getsockopt(socket_, ZMQ_LAST_ENDPOINT, endpoint, &sz);
+            zmq_getsockopt(router_, ZMQ_LAST_ENDPOINT, endpoint, &sz);
             zmq_endpoint = std::string(endpoint);
             LOGGER_DEBUG("Server bound to {}", endpoint);
 
+            requests_out_.bind(requests_endpoint_);
+            requests_in_.connect(requests_endpoint_);
+            results_in_.bind(results_endpoint_);
+
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Error binding to endpoint: ", e.what());
             throw;
         }
+
+        io_thread_ = std::thread([this]() { this->io_loop_(); });
     }
 
-    std::string recv() 
-    { 
+    ~Impl()
+    {
+        close();
+    }
+
+    void io_loop_()
+    {
+        zmq::pollitem_t items[] = {
+            {static_cast<void*>(router_), 0, ZMQ_POLLIN, 0},
+            {static_cast<void*>(results_in_), 0, ZMQ_POLLIN, 0}
+        };
+
         try {
-            zmq::message_t identity;
-            auto id_size = socket_.recv(identity, zmq::recv_flags::none);
-            std::string id_data(static_cast<char*>(identity.data()), id_size.value());
-            rid_queue_.push(id_data);
-
-            int more = 0;
-            size_t more_size = sizeof(more);
-            socket_.getsockopt(ZMQ_RCVMORE, &more, &more_size);
-
-            zmq::message_t message;
-            auto size = socket_.recv(message, zmq::recv_flags::none);
-            std::string data(static_cast<char*>(message.data()), size.value());
-            return data;
+            while (true) {
+                zmq::poll(items, 2, std::chrono::milliseconds{-1});
+
+                if (items[0].revents & ZMQ_POLLIN) {
+                    // [identity, job id, payload] or [identity, payload] for clients without job ids
+                    auto frames = recv_frames(router_);
+                    if (frames.size() == 2)
+                        frames.emplace(frames.begin() + 1);
+                    send_frames(requests_out_, frames);
+                }
+
+                if (items[1].revents & ZMQ_POLLIN) {
+                    // [identity, job id, result], an empty job id is not sent back
+                    auto frames = recv_frames(results_in_);
+                    if (frames.size() == 3 && frames[1].size() == 0)
+                        frames.erase(frames.begin() + 1);
+                    send_frames(router_, frames);
+                }
+            }
+        } catch (const zmq::error_t& e) {
+            if (e.num() != ETERM)
+                LOGGER_ERROR("Error in the server I/O thread: {}", e.what());
+        }
+
+        router_.close();
+        requests_out_.close();
+        results_in_.close();
+    }
+
+    zmq::socket_t& push_socket_()
+    {
+        // zmq sockets are not thread-safe, so each compute thread gets its own PUSH socket
+        thread_local std::unordered_map<std::size_t, zmq::socket_t*> sockets;
+        auto& socket = sockets[instance_id_];
+        if (!socket) {
+            std::lock_guard<std::mutex> lock(push_sockets_mutex_);
+            push_sockets_.push_back(std::make_unique<zmq::socket_t>(context_, zmq::socket_type::push));
+            push_sockets_.back()->connect(results_endpoint_);
+            socket = push_sockets_.back().get();
+        }
+        return *socket;
+    }
+
+    Message recv()
+    {
+        try {
+            auto frames = recv_frames(requests_in_);
+            return {to_string(frames[0]), to_string(frames[1]), to_string(frames.back())};
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Error receiving data: {}", e.what());
-            return std::string("CLOSE");
+            return {std::string(), std::string(), std::string("CLOSE")};
         }
     }
 
-    void send(const std::string& result) 
+    void send(const std::string& result, const std::string& client_id, const std::string& job_id)
     {
         try {
-            zmq::message_t message(result.begin(), result.end());
-            //message.set_routing_id(rid_queue_.front());
-            std::string recvr_id = rid_queue_.front();
-            rid_queue_.pop();
-            zmq::message_t identity_frame(recvr_id.begin(), recvr_id.end());
-
-            socket_.send(identity_frame, zmq::send_flags::sndmore);
-            socket_.send(message, zmq::send_flags::none);
+            std::vector<zmq::message_t> frames;
+            frames.emplace_back(client_id.begin(), client_id.end());
+            frames.emplace_back(job_id.begin(), job_id.end());
+            frames.emplace_back(result.begin(), result.end());
+            send_frames(push_socket_(), frames);
         } catch (const zmq::error_t& e) {
             LOGGER_ERROR("Error sending result: {}", e.what());
             throw;
@@ -74,7 +177,17 @@ struct Server::Impl {
 
     void close()
     {
-        socket_.close();
+        if (!io_thread_.joinable())
+            return;
+
+        // Makes every blocking call on the context fail with ETERM, the I/O thread included
+        zmq_ctx_shutdown(static_cast<void*>(context_));
+        io_thread_.join();
+
+        requests_in_.close();
+        std::lock_guard<std::mutex> lock(push_sockets_mutex_);
+        for (auto& socket : push_sockets_)
+            socket->close();
     }
 };
 
@@ -94,15 +207,15 @@ void Server::accept()
     // ZMQ does not need to accept connection as Asio
 }
 
-std::string Server::recv_data() 
+Message Server::recv_data() 
 { 
     return pimpl_->recv();
 }
 
-void Server::send_result(const std::string& result) 
+void Server::send_result(const std::string& result, const std::string& client_id, const std::string& job_id) 
 { 
     try {
-        pimpl_->send(result);
+        pimpl_->send(result, client_id, job_id);
     } catch (const std::exception& e) {
         throw ServerException(e.what());
     }
@@ -114,4 +227,4 @@ void Server::close()
 }
 
 } // End of comm namespace
-} // End of cunqa namespace
+} // End of cunqa namespace
\ No newline at end of file
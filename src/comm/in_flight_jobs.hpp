@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "comm/protocol.hpp"
+#include "logger.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Jobs a client has sent and has not got the answer of yet, kept in case the QPU is busy and
+// they have to be sent again. Cancelled jobs stay until their answer arrives, so that a busy
+// answer to them is neither retried nor reported as an error.
+class InFlightJobs {
+public:
+    void add(const std::string& job_id, const std::string& data) { jobs_.emplace(job_id, Job{data, 0, false}); }
+
+    void cancel(const std::string& job_id)
+    {
+        if (auto job = jobs_.find(job_id); job != jobs_.end())
+            job->second.cancelled = true;
+    }
+
+    void clear() { jobs_.clear(); }
+
+    // Takes the answer to a job. If the QPU was busy the job is sent again with `send(data)` after
+    // a backoff and false is returned, as its answer is still to come. A busy answer to a
+    // cancelled job is turned into its cancellation.
+    template <typename Send>
+    bool settle(const std::string& job_id, std::string& result, Send&& send)
+    {
+        auto job = jobs_.find(job_id);
+        auto retry_after_ms = retry_after(result);
+        if (job == jobs_.end() || !retry_after_ms) {
+            if (job != jobs_.end())
+                jobs_.erase(job);
+            return true;
+        }
+
+        if (job->second.cancelled) {
+            result = cancelled_response();
+        } else if (job->second.attempts >= MAX_BUSY_RETRIES) {
+            LOGGER_ERROR("QPU still busy, job {} is given up.", job_id);
+        } else {
+            auto delay = backoff_delay(*retry_after_ms, job->second.attempts++);
+            LOGGER_DEBUG("QPU busy, sending job {} again in {} ms.", job_id, delay.count());
+            std::this_thread::sleep_for(delay);
+            send(job->second.data);
+            return false;
+        }
+        jobs_.erase(job);
+        return true;
+    }
+
+private:
+    struct Job {
+        std::string data;
+        int attempts;
+        bool cancelled;
+    };
+
+    std::unordered_map<std::string, Job> jobs_;
+};
+
+} // End of comm namespace
+} // End of cunqa namespace
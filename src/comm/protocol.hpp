@@ -0,0 +1,55 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+namespace comm {
+
+// Payload sent by a client, under the id of one of its jobs, to cancel that job
+constexpr auto CANCEL_MESSAGE = "CANCEL";
+
+// Answer sent instead of the result of a cancelled job
+inline std::string cancelled_response()
+{
+    return JSON({{"CANCELLED", "The task was cancelled before finishing."}}).dump();
+}
+
+// Answer of a QPU whose queue is full: {"BUSY": "...", "retry_after_ms": N}
+inline std::string busy_response(const std::size_t retry_after_ms)
+{
+    JSON busy = {
+        {"BUSY", "QPU queue is full, the task was not accepted."},
+        {"retry_after_ms", retry_after_ms}
+    };
+    return busy.dump();
+}
+
+// Returns the time suggested by the QPU before retrying if the result is a busy answer
+inline std::optional<std::size_t> retry_after(const std::string& result)
+{
+    if (result.compare(0, 8, "{\"BUSY\":") != 0)
+        return std::nullopt;
+
+    auto busy = JSON::parse(result, nullptr, false);
+    if (busy.is_discarded() || !busy.contains("retry_after_ms"))
+        return std::nullopt;
+    return busy.at("retry_after_ms").get<std::size_t>();
+}
+
+constexpr int MAX_BUSY_RETRIES = 20;
+constexpr std::size_t MAX_BACKOFF_MS = 10000;
+
+// Exponential backoff on top of the time suggested by the QPU
+inline std::chrono::milliseconds backoff_delay(const std::size_t retry_after_ms, const int attempt)
+{
+    std::size_t delay = retry_after_ms << std::min(attempt, 5);
+    return std::chrono::milliseconds(std::min(delay, MAX_BACKOFF_MS));
+}
+
+} // End of comm namespace
+} // End of cunqa namespace
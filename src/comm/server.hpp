@@ -22,6 +22,12 @@ public:
     }
 };
 
+struct Message {
+    std::string client_id;
+    std::string job_id;
+    std::string data;
+};
+
 class Server {
 public:
     std::string mode;
@@ -33,8 +39,8 @@ public:
     ~Server();
 
     void accept();
-    std::string recv_data();
-    void send_result(const std::string& result);
+    Message recv_data();
+    void send_result(const std::string& result, const std::string& client_id, const std::string& job_id);
     void close();
 
 private:
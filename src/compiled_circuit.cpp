@@ -0,0 +1,93 @@
+#include <string>
+#include <limits>
+#include <stdexcept>
+
+#include "compiled_circuit.hpp"
+#include "utils/constants.hpp"
+
+namespace cunqa {
+
+namespace {
+
+bool is_decoded_field(const std::string& key)
+{
+    return key == "name" || key == "qubits" || key == "clbits" || key == "params" ||
+           key == "qpus" || key == "instructions" || key == "l_clbits" || key == "r_clbits";
+}
+
+} // End of anonymous namespace
+
+CompiledCircuit::CompiledCircuit(const JSON& instructions)
+{
+    instructions_.reserve(instructions.size());
+    for (const auto& inst : instructions)
+        instructions_.push_back(decode_(inst));
+}
+
+Instruction CompiledCircuit::decode_(const JSON& inst)
+{
+    const auto& name = inst.at("name").get_ref<const std::string&>();
+    auto name_it = constants::INSTRUCTIONS_MAP.find(name);
+    if (name_it == constants::INSTRUCTIONS_MAP.end())
+        throw std::runtime_error("Instruction " + name + " not supported.");
+
+    Instruction decoded{name_it->second, &name_it->first};
+
+    if (inst.contains("qubits")) {
+        for (const auto& qubit : inst.at("qubits"))
+            decoded.qubits.push_back(qubit.get<int>());
+    }
+
+    if (decoded.type == constants::COPY) {
+        const auto& l_clbits = inst.at("l_clbits");
+        const auto& r_clbits = inst.at("r_clbits");
+        if (l_clbits.size() != r_clbits.size())
+            throw std::runtime_error("The number of copied clbits and the number of clbits "
+                                     "copied on does not match.");
+        for (const auto& clbit : l_clbits)
+            decoded.clbits.push_back(clbit.get<int>());
+        for (const auto& clbit : r_clbits)
+            decoded.clbits.push_back(clbit.get<int>());
+    } else if (inst.contains("clbits")) {
+        for (const auto& clbit : inst.at("clbits"))
+            decoded.clbits.push_back(clbit.get<int>());
+    }
+
+    if (inst.contains("params")) {
+        const auto& params = inst.at("params");
+        decoded.params_begin = params_.size();
+        decoded.n_params = params.size();
+        // Parameters not assigned yet are only an error if the instruction is executed
+        for (const auto& param : params)
+            params_.push_back(param.is_number() ? param.get<double>() : std::numeric_limits<double>::quiet_NaN());
+    }
+
+    if (inst.contains("qpus") && !inst.at("qpus").empty()) {
+        decoded.qpu = qpus_.size();
+        qpus_.push_back(inst.at("qpus")[0].get<std::string>());
+    }
+
+    if (inst.contains("instructions")) {
+        // The slots of the block are reserved first, the blocks nested in it go after them
+        const auto& sub_insts = inst.at("instructions");
+        decoded.block_begin = blocks_.size();
+        decoded.block_size = sub_insts.size();
+        blocks_.resize(blocks_.size() + sub_insts.size());
+        for (std::size_t i = 0; i < sub_insts.size(); ++i) {
+            auto sub_inst = decode_(sub_insts[i]);
+            blocks_[decoded.block_begin + i] = std::move(sub_inst);
+        }
+    }
+
+    for (const auto& [key, _] : inst.items()) {
+        if (!is_decoded_field(key)) {
+            decoded.extra = extras_.size();
+            extras_.push_back(inst);
+            break;
+        }
+    }
+
+    return decoded;
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "utils/json.hpp"
+
+namespace cunqa {
+
+// Vector that keeps up to N elements inline, enough for the qubits or clbits of almost
+// every instruction, and only allocates for the bigger ones
+template <typename T, std::size_t N>
+class SmallVector {
+public:
+    SmallVector() = default;
+
+    void push_back(const T& value)
+    {
+        if (size_ < N) {
+            inline_[size_] = value;
+        } else {
+            if (size_ == N)
+                heap_.assign(inline_.begin(), inline_.end());
+            heap_.push_back(value);
+        }
+        ++size_;
+    }
+
+    T* data() { return size_ > N ? heap_.data() : inline_.data(); }
+    const T* data() const { return size_ > N ? heap_.data() : inline_.data(); }
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T& operator[](std::size_t i) { return data()[i]; }
+    const T& operator[](std::size_t i) const { return data()[i]; }
+
+    T* begin() { return data(); }
+    T* end() { return data() + size_; }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size_; }
+
+private:
+    std::array<T, N> inline_{};
+    std::vector<T> heap_;
+    uint32_t size_ = 0;
+};
+
+// An instruction decoded from its JSON. Everything that does not fit inline lives in the
+// CompiledCircuit it belongs to, referenced by index so that copies of the circuit stay valid.
+struct Instruction {
+    int type;                  // One of constants::INSTRUCTIONS
+    const std::string* name;   // Key of constants::INSTRUCTIONS_MAP, valid for the whole program
+    SmallVector<int, 3> qubits;
+    SmallVector<int, 2> clbits; // For "copy", the l_clbits followed by the r_clbits
+    uint32_t params_begin = 0;
+    uint32_t n_params = 0;
+    uint32_t block_begin = 0;  // Instructions of "cif" and "rcontrol"
+    uint32_t block_size = 0;
+    int qpu = -1;
+    int extra = -1;            // Original JSON, for the few instructions with other fields
+};
+
+// Circuit decoded once into a flat instruction stream, so simulators do not walk the
+// JSON on every shot
+class CompiledCircuit {
+public:
+    CompiledCircuit() = default;
+    explicit CompiledCircuit(const JSON& instructions);
+
+    const Instruction* begin() const { return instructions_.data(); }
+    const Instruction* end() const { return instructions_.data() + instructions_.size(); }
+    std::size_t size() const { return instructions_.size(); }
+    bool empty() const { return instructions_.empty(); }
+
+    std::span<const Instruction> block(const Instruction& inst) const
+    {
+        return {blocks_.data() + inst.block_begin, inst.block_size};
+    }
+    std::span<const double> params(const Instruction& inst) const
+    {
+        return {params_.data() + inst.params_begin, inst.n_params};
+    }
+    const std::string& qpu(const Instruction& inst) const { return qpus_.at(inst.qpu); }
+    // Every QPU named by the instructions, in the order of Instruction::qpu
+    const std::vector<std::string>& qpus() const { return qpus_; }
+    const JSON& extra(const Instruction& inst) const { return extras_.at(inst.extra); }
+
+    // Position in the parameter storage of the param-th parameter of a top level instruction
+    std::size_t param_index(std::size_t instruction, std::size_t param) const
+    {
+        return instructions_[instruction].params_begin + param;
+    }
+    void set_param(std::size_t index, double value) { params_[index] = value; }
+
+private:
+    std::vector<Instruction> instructions_;
+    std::vector<Instruction> blocks_;
+    std::vector<double> params_;
+    std::vector<std::string> qpus_;
+    std::vector<JSON> extras_;
+
+    Instruction decode_(const JSON& inst);
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace cunqa {
+
+// Queue shared by all the clients of a QPU. Jobs of higher priority always go first and,
+// within a priority, clients are served by deficit round robin on the cost of their jobs,
+// so a client with many heavy jobs can not starve the rest.
+// Job needs `client_id`, `job_id`, `priority` and `cost` members.
+template <typename Job>
+class JobScheduler {
+public:
+    static constexpr std::size_t QUANTUM = 64 * 1024;
+
+    void push(Job job)
+    {
+        auto& level = levels_[job.priority];
+        auto& client = level.clients[job.client_id];
+        if (client.jobs.empty())
+            level.active.push_back(job.client_id);
+        client.jobs.push_back(std::move(job));
+        ++size_;
+    }
+
+    // Must not be called on an empty scheduler
+    Job pop()
+    {
+        auto level_it = levels_.begin();
+        auto& level = level_it->second;
+
+        while (true) {
+            auto& client_id = level.active.front();
+            auto& client = level.clients.at(client_id);
+
+            if (client.deficit < client.jobs.front().cost) {
+                client.deficit += QUANTUM;
+                level.active.push_back(std::move(client_id));
+                level.active.pop_front();
+                continue;
+            }
+
+            Job job = std::move(client.jobs.front());
+            client.jobs.pop_front();
+            client.deficit -= job.cost;
+            --size_;
+
+            // Idle clients do not keep their deficit
+            if (client.jobs.empty()) {
+                level.clients.erase(client_id);
+                level.active.pop_front();
+                if (level.active.empty())
+                    levels_.erase(level_it);
+            }
+            return job;
+        }
+    }
+
+    // Takes a job out of the queue before it runs, if it is still there
+    std::optional<Job> remove(const std::string& client_id, const std::string& job_id)
+    {
+        for (auto level_it = levels_.begin(); level_it != levels_.end(); ++level_it) {
+            auto& level = level_it->second;
+            auto client_it = level.clients.find(client_id);
+            if (client_it == level.clients.end())
+                continue;
+
+            auto& jobs = client_it->second.jobs;
+            auto job_it = std::find_if(jobs.begin(), jobs.end(), 
+                                       [&job_id](const Job& job) { return job.job_id == job_id; });
+            if (job_it == jobs.end())
+                continue;
+
+            Job job = std::move(*job_it);
+            jobs.erase(job_it);
+            --size_;
+
+            if (jobs.empty()) {
+                level.clients.erase(client_it);
+                level.active.erase(std::find(level.active.begin(), level.active.end(), client_id));
+                if (level.active.empty())
+                    levels_.erase(level_it);
+            }
+            return job;
+        }
+        return std::nullopt;
+    }
+
+    bool empty() const { return size_ == 0; }
+    std::size_t size() const { return size_; }
+
+private:
+    struct ClientQueue {
+        std::deque<Job> jobs;
+        std::size_t deficit = 0;
+    };
+
+    struct Level {
+        std::unordered_map<std::string, ClientQueue> clients;
+        std::deque<std::string> active;
+    };
+
+    std::map<int, Level, std::greater<int>> levels_;
+    std::size_t size_ = 0;
+};
+
+} // End of cunqa namespace
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <numbers>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+#include "param_expression.hpp"
+
+namespace cunqa {
+
+namespace {
+
+constexpr std::size_t MAX_STACK_DEPTH = 64;
+constexpr std::size_t MAX_NESTING = 256;
+
+} // End of anonymous namespace
+
+// Recursive descent parser emitting postfix code. Follows the precedence of Python, which is
+// what sympy prints: unary minus binds weaker than ** ("-x**2" is "-(x**2)").
+//   expr    := term (('+' | '-') term)*
+//   term    := unary (('*' | '/') unary)*
+//   unary   := ('-' | '+') unary | power
+//   power   := primary ('**' unary)?
+//   primary := number | variable | constant | function '(' expr ')' | '(' expr ')'
+class ExpressionParser {
+public:
+    ExpressionParser(const std::string& expression, const std::vector<std::string>& variables,
+                     std::vector<ParamExpression::Op>& program) :
+        expression_{expression},
+        variables_{variables},
+        program_{program}
+    { }
+
+    void parse()
+    {
+        expr_();
+        skip_spaces_();
+        if (pos_ != expression_.size())
+            error_("unexpected character '" + std::string(1, expression_[pos_]) + "'");
+    }
+
+private:
+    using OpCode = ParamExpression::OpCode;
+
+    const std::string& expression_;
+    const std::vector<std::string>& variables_;
+    std::vector<ParamExpression::Op>& program_;
+    std::size_t pos_ = 0;
+    std::size_t nesting_ = 0;
+
+    void expr_()
+    {
+        term_();
+        while (true) {
+            if (accept_('+')) {
+                term_();
+                program_.push_back({OpCode::ADD});
+            } else if (accept_('-')) {
+                term_();
+                program_.push_back({OpCode::SUB});
+            } else {
+                return;
+            }
+        }
+    }
+
+    void term_()
+    {
+        unary_();
+        while (true) {
+            if (peek_() == '*' && expression_.compare(pos_, 2, "**") != 0) {
+                ++pos_;
+                unary_();
+                program_.push_back({OpCode::MUL});
+            } else if (accept_('/')) {
+                unary_();
+                program_.push_back({OpCode::DIV});
+            } else {
+                return;
+            }
+        }
+    }
+
+    void unary_()
+    {
+        if (++nesting_ > MAX_NESTING)
+            error_("too deeply nested");
+
+        if (accept_('-')) {
+            unary_();
+            program_.push_back({OpCode::NEG});
+        } else if (accept_('+')) {
+            unary_();
+        } else {
+            power_();
+        }
+        --nesting_;
+    }
+
+    void power_()
+    {
+        primary_();
+        skip_spaces_();
+        if (expression_.compare(pos_, 2, "**") == 0) {
+            pos_ += 2;
+            unary_();
+            program_.push_back({OpCode::POW});
+        }
+    }
+
+    void primary_()
+    {
+        char c = peek_();
+        if (accept_('(')) {
+            expr_();
+            expect_(')');
+        } else if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+            const char* begin = expression_.c_str() + pos_;
+            char* end;
+            double value = std::strtod(begin, &end);
+            if (end == begin)
+                error_("malformed number");
+            pos_ += end - begin;
+            program_.push_back({OpCode::CONST, value});
+        } else if (std::isalpha(static_cast<unsigned char>(c)) || c == '_') {
+            name_();
+        } else {
+            error_(pos_ == expression_.size() ? "unexpected end" : "unexpected character '" + std::string(1, c) + "'");
+        }
+    }
+
+    void name_()
+    {
+        static const std::unordered_map<std::string_view, OpCode> functions = {
+            {"sin", OpCode::SIN}, {"cos", OpCode::COS}, {"tan", OpCode::TAN},
+            {"asin", OpCode::ASIN}, {"acos", OpCode::ACOS}, {"atan", OpCode::ATAN},
+            {"sinh", OpCode::SINH}, {"cosh", OpCode::COSH}, {"tanh", OpCode::TANH},
+            {"exp", OpCode::EXP}, {"log", OpCode::LOG}, {"sqrt", OpCode::SQRT}, {"Abs", OpCode::ABS}
+        };
+
+        std::size_t begin = pos_;
+        while (pos_ < expression_.size() &&
+               (std::isalnum(static_cast<unsigned char>(expression_[pos_])) || expression_[pos_] == '_'))
+            ++pos_;
+        std::string name = expression_.substr(begin, pos_ - begin);
+
+        for (std::size_t i = 0; i < variables_.size(); ++i) {
+            if (variables_[i] == name) {
+                program_.push_back({OpCode::VAR, 0.0, static_cast<int>(i)});
+                return;
+            }
+        }
+        if (name == "pi") {
+            program_.push_back({OpCode::CONST, std::numbers::pi});
+        } else if (name == "E") {
+            program_.push_back({OpCode::CONST, std::numbers::e});
+        } else if (auto function = functions.find(name); function != functions.end()) {
+            expect_('(');
+            expr_();
+            expect_(')');
+            program_.push_back({function->second});
+        } else {
+            error_("unknown name " + name);
+        }
+    }
+
+    void skip_spaces_()
+    {
+        while (pos_ < expression_.size() && std::isspace(static_cast<unsigned char>(expression_[pos_])))
+            ++pos_;
+    }
+
+    char peek_()
+    {
+        skip_spaces_();
+        return pos_ < expression_.size() ? expression_[pos_] : '\0';
+    }
+
+    bool accept_(const char c)
+    {
+        if (peek_() != c)
+            return false;
+        ++pos_;
+        return true;
+    }
+
+    void expect_(const char c)
+    {
+        if (!accept_(c))
+            error_("expected '" + std::string(1, c) + "'");
+    }
+
+    [[noreturn]] void error_(const std::string& what)
+    {
+        throw std::runtime_error("Error compiling parameter expression \"" + expression_ + "\": " + what + ".");
+    }
+};
+
+ParamExpression::ParamExpression(const std::string& expression, const std::vector<std::string>& variables)
+{
+    ExpressionParser(expression, variables, program_).parse();
+
+    std::size_t depth = 0;
+    for (const auto& op : program_) {
+        switch (op.code) {
+            case OpCode::CONST:
+            case OpCode::VAR:
+                max_depth_ = std::max(max_depth_, ++depth);
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+            case OpCode::DIV:
+            case OpCode::POW:
+                --depth;
+                break;
+            default:
+                break;
+        }
+    }
+    if (max_depth_ > MAX_STACK_DEPTH)
+        throw std::runtime_error("Error compiling parameter expression \"" + expression + "\": too deeply nested.");
+}
+
+double ParamExpression::evaluate(std::span<const double> variables) const
+{
+    std::array<double, MAX_STACK_DEPTH> stack;
+    std::size_t top = 0;
+
+    for (const auto& op : program_) {
+        switch (op.code) {
+            case OpCode::CONST: stack[top++] = op.value; break;
+            case OpCode::VAR:   stack[top++] = variables[op.index]; break;
+            case OpCode::ADD:   --top; stack[top - 1] += stack[top]; break;
+            case OpCode::SUB:   --top; stack[top - 1] -= stack[top]; break;
+            case OpCode::MUL:   --top; stack[top - 1] *= stack[top]; break;
+            case OpCode::DIV:   --top; stack[top - 1] /= stack[top]; break;
+            case OpCode::POW:   --top; stack[top - 1] = std::pow(stack[top - 1], stack[top]); break;
+            case OpCode::NEG:   stack[top - 1] = -stack[top - 1]; break;
+            case OpCode::SIN:   stack[top - 1] = std::sin(stack[top - 1]); break;
+            case OpCode::COS:   stack[top - 1] = std::cos(stack[top - 1]); break;
+            case OpCode::TAN:   stack[top - 1] = std::tan(stack[top - 1]); break;
+            case OpCode::ASIN:  stack[top - 1] = std::asin(stack[top - 1]); break;
+            case OpCode::ACOS:  stack[top - 1] = std::acos(stack[top - 1]); break;
+            case OpCode::ATAN:  stack[top - 1] = std::atan(stack[top - 1]); break;
+            case OpCode::SINH:  stack[top - 1] = std::sinh(stack[top - 1]); break;
+            case OpCode::COSH:  stack[top - 1] = std::cosh(stack[top - 1]); break;
+            case OpCode::TANH:  stack[top - 1] = std::tanh(stack[top - 1]); break;
+            case OpCode::EXP:   stack[top - 1] = std::exp(stack[top - 1]); break;
+            case OpCode::LOG:   stack[top - 1] = std::log(stack[top - 1]); break;
+            case OpCode::SQRT:  stack[top - 1] = std::sqrt(stack[top - 1]); break;
+            case OpCode::ABS:   stack[top - 1] = std::abs(stack[top - 1]); break;
+        }
+    }
+
+    return stack[0];
+}
+
+} // End of cunqa namespace
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace cunqa {
+
+// Arithmetic expression of a gate parameter in terms of the free variables of the circuit,
+// as printed by sympy (e.g. "2*theta + phi**2", "sin(theta)/2"). It is compiled once into
+// a postfix program that is evaluated on a small stack for every new set of variables.
+class ParamExpression {
+public:
+    ParamExpression() = default;
+    // Throws if the expression uses an unknown name or is not well formed
+    ParamExpression(const std::string& expression, const std::vector<std::string>& variables);
+
+    // `variables` in the same order as the names given when compiling
+    double evaluate(std::span<const double> variables) const;
+
+private:
+    enum class OpCode {
+        CONST, VAR, ADD, SUB, MUL, DIV, POW, NEG,
+        SIN, COS, TAN, ASIN, ACOS, ATAN, SINH, COSH, TANH, EXP, LOG, SQRT, ABS
+    };
+
+    struct Op {
+        OpCode code;
+        double value = 0.0; // For CONST
+        int index = 0;      // For VAR
+    };
+
+    std::vector<Op> program_;
+    std::size_t max_depth_ = 0;
+
+    friend class ExpressionParser;
+};
+
+} // End of cunqa namespace
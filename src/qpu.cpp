@@ -1,8 +1,15 @@
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 #include "utils/constants.hpp"
 #include "qpu.hpp"
+#include "comm/protocol.hpp"
 #include "logger.hpp"
 
 using namespace std::string_literals;
@@ -10,55 +17,341 @@ using namespace std::string_literals;
 namespace cunqa {
 
 QPU::QPU(std::unique_ptr<sim::Backend> backend, const std::string& mode, 
-         const std::string& name, const std::string& family) :
+         const std::string& name, const std::string& family, const std::size_t n_workers, 
+         const std::size_t max_queued_jobs, const std::size_t max_queued_bytes, 
+         const std::size_t result_cache_entries, const std::size_t result_cache_bytes, 
+         const std::size_t max_coalesced_jobs) :
     backend{std::move(backend)},
     server{std::make_unique<comm::Server>(mode)},
+    max_queued_jobs_{max_queued_jobs > 0 ? max_queued_jobs : 1},
+    max_queued_bytes_{max_queued_bytes},
+    result_cache_{result_cache_entries, result_cache_bytes},
+    family_{family},
     name_{name},
-    family_{family}
+    n_workers_{n_workers > 0 ? n_workers : 1},
+    max_coalesced_jobs_{max_coalesced_jobs > 0 ? max_coalesced_jobs : 1}
 { }
 
 void QPU::turn_ON() 
 {
     std::thread listen([this](){this->recv_data_();});
-    std::thread compute([this](){this->compute_result_();});
+    std::vector<std::thread> compute;
+    for (std::size_t i = 0; i < n_workers_; ++i)
+        compute.emplace_back([this](){this->compute_result_();});
+    LOGGER_DEBUG("QPU {} running with {} compute threads.", name_, n_workers_);
 
     JSON qpu_config = *this;
     write_on_file(qpu_config, constants::QPUS_FILEPATH, name_);
 
     listen.join();
-    compute.join();
+    for (auto& worker : compute)
+        worker.join();
 }
 
 void QPU::compute_result_()
 {    
+    // Each worker owns its task, so parsing and simulation never share state between threads
     QuantumTask quantum_task_; 
+    std::shared_ptr<const std::string> current_circuit;
     while (true) 
     {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        queue_condition_.wait(lock, [this] { return !message_queue_.empty(); });
+        Job job;
+        auto abort_flag = std::make_shared<std::atomic<bool>>(false);
+        std::vector<Job> coalesced;
+        std::shared_ptr<BatchSets> sets;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex_);
+            queue_condition_.wait(lock, [this] { return !scheduler_.empty() || !batch_sets_.empty(); });
+            // Helping with a running batch comes before taking new jobs
+            if (!batch_sets_.empty()) {
+                sets = std::move(batch_sets_.front());
+                batch_sets_.pop_front();
+            } else {
+                job = scheduler_.pop();
+                queued_bytes_ -= job.bytes;
+                running_[job.client_id + "/"s + job.job_id] = abort_flag;
+
+                while (coalesced.size() + 1 < max_coalesced_jobs_ && !scheduler_.empty()) {
+                    coalesced.push_back(scheduler_.pop());
+                    queued_bytes_ -= coalesced.back().bytes;
+                    running_[coalesced.back().client_id + "/"s + coalesced.back().job_id] = std::make_shared<std::atomic<bool>>(false);
+                }
+            }
+        }
+        if (sets) {
+            run_batch_sets_(*sets);
+            continue;
+        }
+        if (!coalesced.empty()) {
+            coalesced.insert(coalesced.begin(), std::move(job));
+            execute_coalesced_(coalesced);
+            continue;
+        }
+        auto stop_running = [&]() {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            running_.erase(job.client_id + "/"s + job.job_id);
+        };
+
+        try {
+            if (!job.circuit) 
+                throw std::runtime_error("Circuit not sent before updating parameters.");
+
+            if (job.circuit != current_circuit || job.params.empty()) {
+                quantum_task_.update_circuit(*job.circuit);
+                current_circuit = job.circuit;
+            }
+            if (!job.params.empty())
+                quantum_task_.update_circuit(job.params);
+            quantum_task_.abort_flag = abort_flag;
+
+            auto cache_key = result_cache_.enabled() && quantum_task_.batch.empty() ? ResultCache::key(quantum_task_) : std::nullopt;
+            if (cache_key) {
+                if (auto cached = result_cache_.get(*cache_key)) {
+                    LOGGER_DEBUG("Result cache hit ({} hits, {} misses).", result_cache_.hits(), result_cache_.misses());
+                    stop_running();
+                    server->send_result(*cached, job.client_id, job.job_id);
+                    continue;
+                }
+                LOGGER_DEBUG("Result cache miss ({} hits, {} misses).", result_cache_.hits(), result_cache_.misses());
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            auto result = quantum_task_.batch.empty() ? backend->execute(quantum_task_) : execute_batch_(quantum_task_);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            mean_task_ms_.store(0.8 * mean_task_ms_.load() + 0.2 * elapsed.count());
+
+            stop_running();
+            if (abort_flag->load()) {
+                server->send_result(comm::cancelled_response(), job.client_id, job.job_id);
+            } else {
+                auto result_str = result.dump();
+                if (cache_key)
+                    result_cache_.put(*cache_key, result_str);
+                server->send_result(result_str, job.client_id, job.job_id);
+            }
+
+        } catch(const comm::ServerException& e) {
+            LOGGER_ERROR("There has happened an error sending the result, probably the client has had an error.");
+            LOGGER_ERROR("Message of the error: {}", e.what());
+        } catch(const std::exception& e) {
+            LOGGER_ERROR("There has happened an error sending the result, the server keeps on iterating.");
+            LOGGER_ERROR("Message of the error: {}", e.what());
+            stop_running();
+            // The task may be half updated, force a fresh parse on the next job
+            current_circuit.reset();
+            server->send_result("{\"ERROR\":\""s + std::string(e.what()) + "\"}"s, job.client_id, job.job_id);
+        }
+    }
+}
+
+struct QPU::BatchSets {
+    BatchSets(const QuantumTask& quantum_task, const std::size_t n_sets) :
+        quantum_task{quantum_task}, results(n_sets)
+    { }
+
+    const QuantumTask& quantum_task;
+    std::vector<JSON> results;
+    std::atomic<std::size_t> next_set{0};
+    std::size_t active = 0; // Workers running some set
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+JSON QPU::execute_batch_(const QuantumTask& quantum_task)
+{
+    if (auto result = backend->execute_batch(quantum_task)) {
+        LOGGER_DEBUG("Batch of {} parameter sets executed by the simulator.", quantum_task.batch.size());
+        return *result;
+    }
+
+    // The sets are shared out among the worker running the batch and as many idle workers as 
+    // take them, each one binding them on its own copy of the task
+    const std::size_t n_sets = quantum_task.batch.size();
+    auto sets = std::make_shared<BatchSets>(quantum_task, n_sets);
+    if (std::size_t n_helpers = std::min(n_sets, n_workers_) - 1; n_helpers > 0) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            batch_sets_.insert(batch_sets_.end(), n_helpers, sets);
+        }
+        queue_condition_.notify_all();
+    }
+    run_batch_sets_(*sets);
+
+    // Workers that did not get to help are not waited for
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        std::erase(batch_sets_, sets);
+    }
+    std::unique_lock<std::mutex> lock(sets->mutex);
+    sets->next_set = n_sets;
+    sets->done.wait(lock, [&] { return sets->active == 0; });
+
+    if (sets->error)
+        std::rethrow_exception(sets->error);
+    LOGGER_DEBUG("Batch of {} parameter sets executed.", n_sets);
+    return JSON{{"batch", std::move(sets->results)}};
+}
+
+void QPU::run_batch_sets_(BatchSets& sets)
+{
+    const std::size_t n_sets = sets.results.size();
+    {
+        // Once the sets are all taken the task may be gone, so it is not touched
+        std::lock_guard<std::mutex> lock(sets.mutex);
+        if (sets.next_set >= n_sets)
+            return;
+        ++sets.active;
+    }
+
+    QuantumTask task = sets.quantum_task;
+    task.batch.clear();
+    task.batch_shots.clear();
+    try {
+        for (std::size_t i = sets.next_set++; i < n_sets && !task.is_cancelled(); i = sets.next_set++) {
+            task.bind_params(sets.quantum_task.batch[i]);
+            if (!sets.quantum_task.batch_shots.empty())
+                task.config["shots"] = sets.quantum_task.batch_shots[i];
+            sets.results[i] = backend->execute(task);
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(sets.mutex);
+        if (!sets.error)
+            sets.error = std::current_exception();
+        sets.next_set = n_sets;
+    }
+
+    std::lock_guard<std::mutex> lock(sets.mutex);
+    if (--sets.active == 0)
+        sets.done.notify_all();
+}
 
-        while (!message_queue_.empty()) 
+void QPU::execute_coalesced_(const std::vector<Job>& jobs)
+{
+    // Each job is answered on its own, whatever happens to the rest
+    auto answer = [this](const Job& job, const std::string& result) {
+        bool cancelled;
         {
-            try {
-                std::string message = message_queue_.front();
-                message_queue_.pop();
-                lock.unlock();
-                
-                quantum_task_.update_circuit(message);
-                auto result = backend->execute(quantum_task_);
-                server->send_result(result.dump());
-
-            } catch(const comm::ServerException& e) {
-                LOGGER_ERROR("There has happened an error sending the result, probably the client has had an error.");
-                LOGGER_ERROR("Message of the error: {}", e.what());
-            } catch(const std::exception& e) {
-                LOGGER_ERROR("There has happened an error sending the result, the server keeps on iterating.");
-                LOGGER_ERROR("Message of the error: {}", e.what());
-                server->send_result("{\"ERROR\":\""s + std::string(e.what()) + "\"}"s);
+            std::lock_guard<std::mutex> lock(queue_mutex_);
+            auto it = running_.find(job.client_id + "/"s + job.job_id);
+            cancelled = it != running_.end() && it->second->load();
+            running_.erase(job.client_id + "/"s + job.job_id);
+        }
+        try {
+            server->send_result(cancelled ? comm::cancelled_response() : result, job.client_id, job.job_id);
+        } catch(const comm::ServerException& e) {
+            LOGGER_ERROR("There has happened an error sending the result, probably the client has had an error.");
+            LOGGER_ERROR("Message of the error: {}", e.what());
+        }
+    };
+    auto error_response = [](const std::exception& e) { return "{\"ERROR\":\""s + std::string(e.what()) + "\"}"s; };
+
+    // Batches and dynamic or communicating tasks can not go with the rest
+    std::vector<QuantumTask> tasks;
+    std::vector<const Job*> task_jobs;
+    std::vector<std::optional<ResultCache::Key>> cache_keys;
+    for (const auto& job : jobs) {
+        try {
+            if (!job.circuit) 
+                throw std::runtime_error("Circuit not sent before updating parameters.");
+            QuantumTask quantum_task(*job.circuit);
+            if (!job.params.empty())
+                quantum_task.update_circuit(job.params);
+
+            if (!quantum_task.batch.empty() || quantum_task.is_dynamic || !quantum_task.sending_to.empty()) {
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    quantum_task.abort_flag = running_.at(job.client_id + "/"s + job.job_id);
+                }
+                auto result = quantum_task.batch.empty() ? backend->execute(quantum_task) : execute_batch_(quantum_task);
+                answer(job, result.dump());
+                continue;
+            }
+
+            auto cache_key = result_cache_.enabled() ? ResultCache::key(quantum_task) : std::nullopt;
+            if (cache_key) {
+                if (auto cached = result_cache_.get(*cache_key)) {
+                    answer(job, *cached);
+                    continue;
+                }
             }
-            lock.lock();
+            tasks.push_back(std::move(quantum_task));
+            task_jobs.push_back(&job);
+            cache_keys.push_back(cache_key);
+        } catch (const std::exception& e) {
+            LOGGER_ERROR("Error executing a coalesced job: {}", e.what());
+            answer(job, error_response(e));
+        }
+    }
+    if (tasks.empty())
+        return;
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        auto results = tasks.size() > 1 ? backend->execute_many(tasks) : std::nullopt;
+        if (!results) {
+            results.emplace();
+            for (const auto& quantum_task : tasks)
+                results->push_back(backend->execute(quantum_task));
+        }
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        mean_task_ms_.store(0.8 * mean_task_ms_.load() + 0.2 * elapsed.count() / tasks.size());
+        LOGGER_DEBUG("{} coalesced jobs executed.", tasks.size());
+
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            auto result_str = (*results)[i].dump();
+            if (cache_keys[i])
+                result_cache_.put(*cache_keys[i], result_str);
+            answer(*task_jobs[i], result_str);
+        }
+    } catch (const std::exception& e) {
+        LOGGER_ERROR("Error executing coalesced jobs: {}", e.what());
+        for (const auto* job : task_jobs)
+            answer(*job, error_response(e));
+    }
+}
+
+std::size_t QPU::estimate_retry_after_ms_(const std::size_t queued_jobs) const
+{
+    // Time for the workers to go through the jobs already queued
+    double estimate = mean_task_ms_.load() * (static_cast<double>(queued_jobs) / n_workers_ + 1.0);
+    return static_cast<std::size_t>(std::clamp(estimate, 10.0, 10000.0));
+}
+
+void QPU::cancel_job_(const std::string& client_id, const std::string& job_id)
+{
+    // A queued job is answered right away, a running one stops at its next shot
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (auto job = scheduler_.remove(client_id, job_id)) {
+            queued_bytes_ -= job->bytes;
+        } else {
+            if (auto it = running_.find(client_id + "/"s + job_id); it != running_.end())
+                it->second->store(true);
+            return;
         }
     }
+    LOGGER_DEBUG("Job {} cancelled before running.", job_id);
+    server->send_result(comm::cancelled_response(), client_id, job_id);
+}
+
+QPU::ClientCircuit& QPU::client_circuit_(const std::string& client_id)
+{
+    // Clients never say they are gone, so a long lived QPU only remembers the latest ones.
+    // Parameter updates from a forgotten client fail as if it had sent no circuit.
+    if (auto it = client_circuits_.find(client_id); it != client_circuits_.end()) {
+        client_order_.splice(client_order_.begin(), client_order_, it->second.order);
+        return it->second;
+    }
+
+    if (client_circuits_.size() >= MAX_CLIENT_CIRCUITS) {
+        client_circuits_.erase(client_order_.back());
+        client_order_.pop_back();
+    }
+    client_order_.push_front(client_id);
+    auto& client = client_circuits_[client_id];
+    client.order = client_order_.begin();
+    return client;
 }
 
 void QPU::recv_data_() 
@@ -67,16 +360,64 @@ void QPU::recv_data_()
     while (true) {
         try {
             auto message = server->recv_data();
+            if (message.data.compare("CLOSE"s) == 0) {
+                server->accept();
+                continue;
+            }
+            if (message.data == comm::CANCEL_MESSAGE) {
+                cancel_job_(message.client_id, message.job_id);
+                continue;
+            }
+
+            std::optional<std::size_t> retry_after_ms;
             {
                 std::lock_guard<std::mutex> lock(queue_mutex_);
-                if (message.compare("CLOSE"s) == 0) {
-                    server->accept();
-                    continue;
+
+                auto& client = client_circuit_(message.client_id);
+                bool params_update = is_params_update(message.data);
+                Job job{message.client_id, message.job_id, nullptr, "", message.data.size(), 0, 0};
+                if (params_update) {
+                    job.circuit = client.circuit;
+                    job.priority = client.priority;
+                    job.params = std::move(message.data);
+                } else {
+                    job.circuit = std::make_shared<const std::string>(std::move(message.data));
+                    job.priority = get_priority(*job.circuit);
+                }
+                // Parameter updates run the whole circuit again, so they cost as much as it
+                job.cost = (job.circuit ? job.circuit->size() : 0) + job.params.size();
+
+                // A single job bigger than the byte limit is still accepted on an empty queue.
+                // The parameter updates of a rejected circuit are rejected with it, so that 
+                // the client sends them again after the circuit instead of applying them to 
+                // the previous one.
+                bool full = scheduler_.size() >= max_queued_jobs_ || 
+                            (!scheduler_.empty() && queued_bytes_ + job.bytes > max_queued_bytes_) ||
+                            (params_update && client.rejected);
+                if (full) {
+                    retry_after_ms = estimate_retry_after_ms_(scheduler_.size());
+                    if (!params_update)
+                        client.rejected = true;
+                } else {
+                    if (!params_update) {
+                        client.circuit = job.circuit;
+                        client.priority = job.priority;
+                        client.rejected = false;
+                    }
+                    queued_bytes_ += job.bytes;
+                    scheduler_.push(std::move(job));
                 }
-                else
-                    message_queue_.push(message);
+            }
+
+            if (retry_after_ms) {
+                LOGGER_DEBUG("Queue full, job {} rejected.", message.job_id);
+                server->send_result(comm::busy_response(*retry_after_ms), message.client_id, message.job_id);
+                continue;
             }
             queue_condition_.notify_one();
+        } catch (const comm::ServerException& e) {
+            LOGGER_ERROR("There has happened an error answering the client, probably the client has had an error.");
+            LOGGER_ERROR("Message of the error: {}", e.what());
         } catch (const std::exception& e) {
             LOGGER_INFO("There has happened an error receiving the circuit, the server keeps on iterating.");
             LOGGER_ERROR("Official message of the error: {}", e.what());
@@ -87,4 +428,3 @@ void QPU::recv_data_()
 
 
 } // End of cunqa namespace
-
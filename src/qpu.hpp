@@ -3,11 +3,16 @@
 #include <string>
 #include <vector>
 #include <thread>
-#include <queue>
+#include <unordered_map>
+#include <list>
+#include <deque>
+#include <memory>
 #include <atomic>
 #include <condition_variable>
 
 #include "comm/server.hpp"
+#include "job_scheduler.hpp"
+#include "result_cache.hpp"
 #include "backends/backend.hpp"
 #include "utils/json.hpp"
 
@@ -17,22 +22,82 @@ namespace cunqa {
 
 class QPU {
 public:    
+    static constexpr std::size_t DEFAULT_MAX_QUEUED_JOBS = 1024;
+    static constexpr std::size_t DEFAULT_MAX_QUEUED_BYTES = 1024UL * 1024 * 1024;
+    static constexpr std::size_t DEFAULT_RESULT_CACHE_BYTES = 64UL * 1024 * 1024;
+    // Clients whose last circuit is kept, the least recently seen are forgotten beyond it
+    static constexpr std::size_t MAX_CLIENT_CIRCUITS = 1024;
+
     std::unique_ptr<sim::Backend> backend;
     std::unique_ptr<comm::Server> server;
 
     QPU(std::unique_ptr<sim::Backend> backend, const std::string& mode, 
-        const std::string& name, const std::string& family);
+        const std::string& name, const std::string& family, 
+        const std::size_t n_workers = 1, 
+        const std::size_t max_queued_jobs = DEFAULT_MAX_QUEUED_JOBS, 
+        const std::size_t max_queued_bytes = DEFAULT_MAX_QUEUED_BYTES, 
+        const std::size_t result_cache_entries = 0, 
+        const std::size_t result_cache_bytes = DEFAULT_RESULT_CACHE_BYTES, 
+        const std::size_t max_coalesced_jobs = 1);
     void turn_ON();
 
 private:
-    std::queue<std::string> message_queue_;
+    // A unit of work for the compute threads. Parameter updates carry the circuit they 
+    // refer to, so any worker can execute them regardless of what it ran before.
+    struct Job {
+        std::string client_id;
+        std::string job_id;
+        std::shared_ptr<const std::string> circuit;
+        std::string params;
+        std::size_t bytes;
+        int priority;
+        std::size_t cost;
+    };
+
+    struct ClientCircuit {
+        std::shared_ptr<const std::string> circuit;
+        int priority = 0;
+        bool rejected = false; // The last circuit sent was not queued
+        std::list<std::string>::iterator order;
+    };
+
+    // Jobs beyond these limits are answered with a busy response instead of being queued
+    JobScheduler<Job> scheduler_;
+    std::size_t queued_bytes_ = 0;
+    std::size_t max_queued_jobs_;
+    std::size_t max_queued_bytes_;
+    std::atomic<double> mean_task_ms_{0.0};
+
+    // Abort flags of the jobs being executed, by client and job id
+    std::unordered_map<std::string, std::shared_ptr<std::atomic<bool>>> running_;
+
+    // Results of seeded tasks, disabled unless it is given some entries
+    ResultCache result_cache_;
+
+    // Batches whose parameter sets idle workers can help with, one entry per helper wanted
+    struct BatchSets;
+    std::deque<std::shared_ptr<BatchSets>> batch_sets_;
+
+    // Last circuit sent by each client, the one its parameter updates refer to
+    std::unordered_map<std::string, ClientCircuit> client_circuits_;
+    std::list<std::string> client_order_; // Most recently seen first
     std::condition_variable queue_condition_;
     std::mutex queue_mutex_;
+
     std::string family_;
     std::string name_;
+    std::size_t n_workers_;
+    // Queued jobs a worker takes at once for the backend to execute them together
+    std::size_t max_coalesced_jobs_;
 
     void compute_result_();
     void recv_data_();
+    void cancel_job_(const std::string& client_id, const std::string& job_id);
+    ClientCircuit& client_circuit_(const std::string& client_id);
+    JSON execute_batch_(const QuantumTask& quantum_task);
+    void run_batch_sets_(BatchSets& sets);
+    void execute_coalesced_(const std::vector<Job>& jobs);
+    std::size_t estimate_retry_after_ms_(const std::size_t queued_jobs) const;
     
     friend void to_json(JSON& j, const QPU& obj) {
         JSON backend_json = obj.backend->to_json();
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 #include "quantum_task.hpp"
 #include "utils/json.hpp"
@@ -32,12 +33,53 @@ std::string to_string(const QuantumTask& data)
     return circ_str;
 }
 
+bool is_params_update(const std::string& message)
+{
+    auto is_space = [](char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; };
+    std::size_t pos = 0;
+    while (pos < message.size() && is_space(message[pos])) ++pos;
+    if (pos == message.size() || message[pos] != '{')
+        return false;
+    ++pos;
+    while (pos < message.size() && is_space(message[pos])) ++pos;
+
+    return message.compare(pos, 8, "\"params\"") == 0 || message.compare(pos, 11, "\"variables\"") == 0 ||
+           message.compare(pos, 7, "\"batch\"") == 0;
+}
+
+int get_priority(const std::string& quantum_task)
+{
+    // Only "config" and its "priority" are kept while parsing, the instructions are skipped
+    // without building them, and a "priority" anywhere else is never taken for it
+    auto only_priority = [](int depth, JSON::parse_event_t event, JSON& parsed) {
+        if (event != JSON::parse_event_t::key)
+            return true;
+        return (depth == 1 && parsed == "config") || (depth == 2 && parsed == "priority");
+    };
+
+    auto task = JSON::parse(quantum_task, only_priority, false);
+    if (!task.is_object() || !task.contains("config"))
+        return 0;
+    const auto& config = task.at("config");
+    if (!config.is_object() || !config.contains("priority") || !config.at("priority").is_number_integer())
+        return 0;
+    return config.at("priority").get<int>();
+}
+
 QuantumTask::QuantumTask(const std::string& quantum_task) { update_circuit(quantum_task); }
 
+namespace {
+
+std::atomic<std::uint64_t> last_circuit_version{0};
+
+} // End of anonymous namespace
+
 void QuantumTask::update_circuit(const std::string& quantum_task) 
 {
     auto quantum_task_json = quantum_task == "" ? JSON() : JSON::parse(quantum_task);
     std::vector<std::string> no_communications = {};
+    batch.clear();
+    batch_shots.clear();
 
     if (quantum_task_json.contains("instructions") && quantum_task_json.contains("config")) {
         circuit = quantum_task_json.at("instructions").get<std::vector<JSON>>();
@@ -45,78 +87,191 @@ void QuantumTask::update_circuit(const std::string& quantum_task)
         sending_to = (quantum_task_json.contains("sending_to") ? quantum_task_json.at("sending_to").get<std::vector<std::string>>() : no_communications);
         is_dynamic = ((quantum_task_json.contains("is_dynamic")) ? quantum_task_json.at("is_dynamic").get<bool>() : false);
         id = quantum_task_json.at("id");
-    } else if (quantum_task_json.contains("params"))
-        update_params_(quantum_task_json.at("params"));
+        circuit_version_ = ++last_circuit_version;
+        compile_();
+        build_param_slots_();
+        compile_param_expressions_(quantum_task_json.contains("param_expressions") ? quantum_task_json.at("param_expressions") : JSON());
+        if (quantum_task_json.contains("batch"))
+            update_batch_(quantum_task_json.at("batch"));
+    } else if (quantum_task_json.contains("params")) {
+        auto n_bound = update_params_(quantum_task_json.at("params").get<std::vector<double>>());
+        LOGGER_DEBUG("{} parameters bound.", n_bound);
+    } else if (quantum_task_json.contains("variables")) {
+        auto n_bound = update_variables_(quantum_task_json.at("variables").get<std::vector<double>>());
+        LOGGER_DEBUG("{} parameters bound.", n_bound);
+    } else if (quantum_task_json.contains("batch")) {
+        update_batch_(quantum_task_json.at("batch"));
+    }
+}
+
+const CompiledCircuit& QuantumTask::compiled() const
+{
+    if (!compile_error_.empty())
+        throw std::runtime_error(compile_error_);
+    return compiled_;
+}
+
+void QuantumTask::compile_()
+{
+    // Simulations that hand the JSON to the simulator never use the compiled circuit, 
+    // so an instruction unknown here is only an error for the ones that do
+    try {
+        compiled_ = CompiledCircuit(circuit);
+        compile_error_.clear();
+    } catch (const std::exception& e) {
+        compiled_ = CompiledCircuit();
+        compile_error_ = "Error decoding the circuit: " + std::string(e.what());
+    }
 }
 
     
-void QuantumTask::update_params_(const std::vector<double> params)
+namespace {
+
+// Number of leading parameters that a parameter update assigns to each kind of gate
+uint32_t n_bound_params(const int instruction_type)
+{
+    switch(instruction_type){
+        // One parameter gates 
+        case cunqa::constants::RX:
+        case cunqa::constants::RY:
+        case cunqa::constants::RZ:
+        case cunqa::constants::P:
+        case cunqa::constants::U1:
+        case cunqa::constants::CRX:
+        case cunqa::constants::CRY:
+        case cunqa::constants::CRZ:
+        case cunqa::constants::CP:
+        case cunqa::constants::CU1:
+        case cunqa::constants::RXX:
+        case cunqa::constants::RYY:
+        case cunqa::constants::RZZ:
+        case cunqa::constants::RZX:
+            return 1;
+        // Two parameter gates 
+        case cunqa::constants::U2:
+        case cunqa::constants::R:
+        case cunqa::constants::CU2:
+        case cunqa::constants::CR:
+        case cunqa::constants::MCU2:
+        case cunqa::constants::MCR:
+            return 2;
+        // Three parameter gates 
+        case cunqa::constants::U3:
+        case cunqa::constants::CU3:
+        case cunqa::constants::MCU3:
+            return 3;
+        // Four parameter gates 
+        case cunqa::constants::U:
+        case cunqa::constants::CU:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+} // End of anonymous namespace
+
+void QuantumTask::build_param_slots_()
+{
+    param_slots_.clear();
+    for (uint32_t i = 0; i < circuit.size(); ++i) {
+        const auto& instruction = circuit[i];
+        auto type = cunqa::constants::INSTRUCTIONS_MAP.find(instruction.at("name").get_ref<const std::string&>());
+        if (type == cunqa::constants::INSTRUCTIONS_MAP.end() || !instruction.contains("params"))
+            continue;
+
+        uint32_t n_params = std::min<uint32_t>(n_bound_params(type->second), instruction.at("params").size());
+        for (uint32_t j = 0; j < n_params; ++j) {
+            std::size_t compiled = compile_error_.empty() ? compiled_.param_index(i, j) : 0;
+            param_slots_.push_back({i, j, compiled});
+        }
+    }
+}
+
+void QuantumTask::compile_param_expressions_(const JSON& param_expressions)
+{
+    param_expressions_.clear();
+    n_param_variables_ = 0;
+    param_expressions_error_.clear();
+    if (param_expressions.is_null())
+        return;
+
+    // As with the circuit, an expression that can not be compiled is only an error if the
+    // client relies on it
+    try {
+        auto variables = param_expressions.at("variables").get<std::vector<std::string>>();
+        const auto& expressions = param_expressions.at("expressions");
+        param_expressions_.reserve(expressions.size());
+        for (const auto& expression : expressions)
+            param_expressions_.emplace_back(expression.get<std::string>(), variables);
+        n_param_variables_ = variables.size();
+    } catch (const std::exception& e) {
+        param_expressions_.clear();
+        param_expressions_error_ = e.what();
+    }
+}
+
+std::size_t QuantumTask::update_variables_(const std::vector<double>& variables)
+{
+    if (!param_expressions_error_.empty())
+        throw std::runtime_error(param_expressions_error_);
+    if (variables.size() != n_param_variables_)
+        throw std::runtime_error("Error updating parameters: the circuit has " + std::to_string(n_param_variables_) + 
+                                 " variables but " + std::to_string(variables.size()) + " were given.");
+
+    std::vector<double> params(param_expressions_.size());
+    for (std::size_t i = 0; i < param_expressions_.size(); ++i)
+        params[i] = param_expressions_[i].evaluate(variables);
+
+    return update_params_(params);
+}
+
+void QuantumTask::update_batch_(const JSON& batch_json)
 {
     if (circuit.empty()) 
         throw std::runtime_error("Circuit not sent before updating parameters.");
+    if (!sending_to.empty())
+        throw std::runtime_error("Batches of parameters are not supported for circuits with communications.");
 
-    try{
-        int counter = 0;
-        
-        for (auto& instruction : circuit){
-            std::string name = instruction.at("name");
-            switch(cunqa::constants::INSTRUCTIONS_MAP.at(name)){
-                // One parameter gates 
-                case cunqa::constants::RX:
-                case cunqa::constants::RY:
-                case cunqa::constants::RZ:
-                case cunqa::constants::P:
-                case cunqa::constants::U1:
-                case cunqa::constants::CRX:
-                case cunqa::constants::CRY:
-                case cunqa::constants::CRZ:
-                case cunqa::constants::CP:
-                case cunqa::constants::CU1:
-                case cunqa::constants::RXX:
-                case cunqa::constants::RYY:
-                case cunqa::constants::RZZ:
-                case cunqa::constants::RZX:
-                    instruction.at("params")[0] = params[counter];
-                    counter = counter + 1;
-                    break; 
-                // Two parameter gates 
-                case cunqa::constants::U2:
-                case cunqa::constants::R:
-                case cunqa::constants::CU2:
-                case cunqa::constants::CR:
-                case cunqa::constants::MCU2:
-                case cunqa::constants::MCR:
-                    instruction.at("params")[0] = params[counter];
-                    instruction.at("params")[1] = params[counter + 1];
-                    counter = counter + 2;
-                    break;
-                // Three parameter gates 
-                case cunqa::constants::U3:
-                case cunqa::constants::CU3:
-                case cunqa::constants::MCU3:
-                    instruction.at("params")[0] = params[counter];
-                    instruction.at("params")[1] = params[counter + 1];
-                    instruction.at("params")[2] = params[counter + 2];
-                    counter = counter + 3;
-                    break;
-                // Four parameter gates 
-                case cunqa::constants::U:
-                case cunqa::constants::CU:
-                    instruction.at("params")[0] = params[counter];
-                    instruction.at("params")[1] = params[counter + 1];
-                    instruction.at("params")[2] = params[counter + 2];
-                    instruction.at("params")[3] = params[counter + 3];
-                    counter = counter + 4;
-                    break;
-                default:
-                    break;
-            }
-        }
+    batch = batch_json.at("params").get<std::vector<std::vector<double>>>();
+    if (batch_json.contains("shots") && !batch_json.at("shots").is_null()) {
+        batch_shots = batch_json.at("shots").get<std::vector<int>>();
+        if (batch_shots.size() != batch.size())
+            throw std::runtime_error("Error updating parameters: the batch has " + std::to_string(batch.size()) + 
+                                     " parameter sets but " + std::to_string(batch_shots.size()) + " shots were given.");
+    }
 
-    } catch (const std::exception& e){
+    // Every set is checked before any of them is executed
+    for (const auto& params : batch) {
+        if (params.size() != param_slots_.size())
+            throw std::runtime_error("Error updating parameters: the circuit has " + std::to_string(param_slots_.size()) + 
+                                     " parameters but a set of " + std::to_string(params.size()) + " was given.");
+    }
+    LOGGER_DEBUG("Batch of {} parameter sets received.", batch.size());
+}
+
+std::size_t QuantumTask::update_params_(const std::vector<double>& params)
+{
+    if (circuit.empty()) 
+        throw std::runtime_error("Circuit not sent before updating parameters.");
+
+    if (params.size() != param_slots_.size()) {
         LOGGER_ERROR("Error updating parameters. (check correct size).");
-        throw std::runtime_error("Error updating parameters:" + std::string(e.what())); 
+        throw std::runtime_error("Error updating parameters: the circuit has " + std::to_string(param_slots_.size()) + 
+                                 " parameters but " + std::to_string(params.size()) + " were given.");
     }
+
+    // The JSON feeds the simulators that take the whole circuit and the compiled
+    // instructions the ones that go instruction by instruction, both are kept in sync
+    const bool compiled = compile_error_.empty();
+    for (std::size_t i = 0; i < params.size(); ++i) {
+        const auto& slot = param_slots_[i];
+        circuit[slot.instruction].at("params")[slot.param] = params[i];
+        if (compiled)
+            compiled_.set_param(slot.compiled, params[i]);
+    }
+
+    return params.size();
 }
 
 } // End of cunqa namespace
\ No newline at end of file
@@ -2,6 +2,11 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include "compiled_circuit.hpp"
+#include "param_expression.hpp"
 #include "utils/json.hpp"
 
 namespace cunqa {
@@ -13,17 +18,64 @@ public:
     std::vector<std::string> sending_to;
     bool is_dynamic = false; // C_IF gates & Communications
     std::string id;
+    // Set by the QPU when the job is cancelled while running, checked between shots
+    std::shared_ptr<const std::atomic<bool>> abort_flag;
+    // Parameter sets of a batch job, each one executed on the circuit with its own result. 
+    // If batch_shots is not empty, each set is executed with its shots.
+    std::vector<std::vector<double>> batch;
+    std::vector<int> batch_shots;
 
     QuantumTask() = default;
     QuantumTask(const std::string& quantum_task);
-    QuantumTask(const JSON& circuit, const JSON& config): circuit(circuit), config(config) {};
+    QuantumTask(JSON circuit, JSON config): circuit(std::move(circuit)), config(std::move(config)) {};
 
     void update_circuit(const std::string& quantum_task);
+    // Assigns a full set of parameters, as a parameter update would. Returns the number bound.
+    inline std::size_t bind_params(const std::vector<double>& params) { return update_params_(params); }
+    inline bool is_cancelled() const { return abort_flag && abort_flag->load(std::memory_order_relaxed); }
+
+    // Where each value of a parameter update goes, in the JSON and in the compiled instructions
+    struct ParamSlot {
+        uint32_t instruction;
+        uint32_t param;
+        std::size_t compiled;
+    };
+
+    // Instructions decoded by update_circuit, throws if some of them could not be decoded
+    const CompiledCircuit& compiled() const;
+    inline const std::vector<ParamSlot>& param_slots() const { return param_slots_; }
+    // Changes whenever a full task replaces the circuit, but not with parameter updates, so 
+    // simulators can keep what they derive from the circuit. 0 if the task was not parsed.
+    inline std::uint64_t circuit_version() const { return circuit_version_; }
     
 private:
-    void update_params_(const std::vector<double> params);
+
+    CompiledCircuit compiled_;
+    std::string compile_error_;
+    std::vector<ParamSlot> param_slots_;
+    std::uint64_t circuit_version_ = 0;
+    // Expressions of the parameters in terms of the free variables of the circuit, if the 
+    // client sent them, so that it only has to send the variables on each update
+    std::vector<ParamExpression> param_expressions_;
+    std::size_t n_param_variables_ = 0;
+    std::string param_expressions_error_;
+
+    // Returns the number of parameters bound, throws if it is not the number the circuit takes
+    std::size_t update_params_(const std::vector<double>& params);
+    void compile_();
+    void build_param_slots_();
+    void compile_param_expressions_(const JSON& param_expressions);
+    std::size_t update_variables_(const std::vector<double>& variables);
+    void update_batch_(const JSON& batch_json);
 };
 
 std::string to_string(const QuantumTask& data);
 
+// Cheap check of whether a raw message is a parameter update ({"params": [...]}, 
+// {"variables": [...]} or {"batch": {...}}) rather than a full task, without parsing the whole JSON
+bool is_params_update(const std::string& message);
+
+// Scheduling priority of a task, read from "priority" in its config (0 if not given)
+int get_priority(const std::string& quantum_task);
+
 } // End of cunqa namespace
\ No newline at end of file
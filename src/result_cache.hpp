@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "quantum_task.hpp"
+#include "utils/helpers/murmur_hash.hpp"
+
+namespace cunqa {
+
+// Least recently used cache of results, shared by the compute threads of a QPU.
+// Only tasks with an explicit seed are cached, since without it two runs of the
+// same task are not expected to give the same result.
+class ResultCache {
+public:
+    struct Key {
+        uint64_t high;
+        uint64_t low;
+        bool operator==(const Key& other) const { return high == other.high && low == other.low; }
+    };
+
+    ResultCache(const std::size_t max_entries, const std::size_t max_bytes) :
+        max_entries_{max_entries},
+        max_bytes_{max_bytes}
+    { }
+
+    bool enabled() const { return max_entries_ > 0 && max_bytes_ > 0; }
+
+    // Fingerprint of the instructions and config of a task, if it can be cached. The JSON
+    // objects keep their keys sorted, so their dump is already canonical. Dynamic tasks
+    // may depend on messages from other QPUs and are never cached.
+    static std::optional<Key> key(const QuantumTask& quantum_task)
+    {
+        if (quantum_task.is_dynamic || !quantum_task.config.contains("seed"))
+            return std::nullopt;
+
+        JSON config = quantum_task.config;
+        config.erase("priority"); // Only affects scheduling
+        std::string canonical = quantum_task.circuit.dump() + '\n' + config.dump();
+
+        uint64_t hash[2];
+        murmur::MurmurHash3_x64_128(canonical.data(), canonical.size(), 0, hash);
+        return Key{hash[0], hash[1]};
+    }
+
+    std::optional<std::string> get(const Key& key)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            ++misses_;
+            return std::nullopt;
+        }
+        ++hits_;
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->result;
+    }
+
+    void put(const Key& key, std::string result)
+    {
+        if (result.size() > max_bytes_)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (auto it = index_.find(key); it != index_.end())
+            erase_(it->second);
+
+        bytes_ += result.size();
+        entries_.push_front({key, std::move(result)});
+        index_.emplace(key, entries_.begin());
+
+        while (entries_.size() > max_entries_ || bytes_ > max_bytes_)
+            erase_(std::prev(entries_.end()));
+    }
+
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+
+private:
+    struct Entry {
+        Key key;
+        std::string result;
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const { return static_cast<std::size_t>(key.low); }
+    };
+
+    void erase_(std::list<Entry>::iterator it)
+    {
+        bytes_ -= it->result.size();
+        index_.erase(it->key);
+        entries_.erase(it);
+    }
+
+    std::size_t max_entries_;
+    std::size_t max_bytes_;
+    std::size_t bytes_ = 0;
+    std::list<Entry> entries_; // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    std::mutex mutex_;
+
+    std::atomic<std::size_t> hits_{0};
+    std::atomic<std::size_t> misses_{0};
+};
+
+} // End of cunqa namespace
@@ -151,3 +151,44 @@ def test_qpucircuitmapper_call_wraps_qiskiterror_as_runtimeerror(monkeypatch):
 
     with pytest.raises(RuntimeError) as excinfo:
         mapper(lambda r: r, population=[[1, 2, 3]])
+
+
+def test_qjobmapper_batches_population_bigger_than_qjobs(monkeypatch):
+    q1, q2 = Mock(), Mock()
+    mapper = QJobMapper([q1, q2])
+
+    monkeypatch.setattr(mappers_mod, "gather", 
+                        lambda qjobs: [[f"r{i}" for i in range(len(q.upgrade_parameters.call_args[0][0]))] 
+                                       for q in qjobs])
+
+    population = [np.array([0.1]), np.array([0.2]), np.array([0.3]), np.array([0.4]), np.array([0.5])]
+
+    out = mapper(lambda result: result, population)
+
+    q1.upgrade_parameters.assert_called_once_with([[0.1], [0.2]])
+    q2.upgrade_parameters.assert_called_once_with([[0.3], [0.4], [0.5]])
+    assert out == ["r0", "r1", "r0", "r1", "r2"]
+
+
+def test_qpucircuitmapper_batches_cunqacircuit_sets_per_qpu(monkeypatch):
+    circuit = Mock(spec=mappers_mod.CunqaCircuit)
+    qpu_a, qpu_b = object(), object()
+    mapper = QPUCircuitMapper([qpu_a, qpu_b], circuit, shots=100)
+
+    run_calls = []
+    def fake_run(circuit, qpu, param_values, **run_params):
+        run_calls.append((qpu, param_values, run_params))
+        return param_values
+
+    def fake_gather(qjobs):
+        return [[f"result{p}" for p in params] if isinstance(params[0], list) else f"result{params}" 
+                for params in qjobs]
+
+    monkeypatch.setattr(mappers_mod, "run", fake_run)
+    monkeypatch.setattr(mappers_mod, "gather", fake_gather)
+
+    population = [[0.1], [0.2], [0.3]]
+    out = mapper(lambda result: result, population)
+
+    assert run_calls == [(qpu_a, [[0.1], [0.3]], {"shots": 100}), (qpu_b, [0.2], {"shots": 100})]
+    assert out == ["result[0.1]", "result[0.2]", "result[0.3]"]
@@ -1,6 +1,6 @@
 # test_qjob.py
 import json, os, sys
-from unittest.mock import Mock, patch
+from unittest.mock import Mock, MagicMock, patch
 import pytest
 
 IN_GITHUB_ACTIONS = os.getenv("GITHUB_ACTIONS") == "true"
@@ -13,7 +13,7 @@ else:
 
 import cunqa.qjob as qjob_mod
 from cunqa.qjob import QJob, gather
-from cunqa.circuit.parameter import encoder
+from cunqa.circuit.parameter import encoder, Param
 from sympy import Symbol
 
 
@@ -515,3 +515,124 @@ def test_gather_returns_list_of_results(monkeypatch):
 def test_gather_with_non_iterable_raises():
     with pytest.raises(AttributeError) as _:
         _ = gather(None)
+
+
+# ------------------------------
+# QJob.cancel method
+# ------------------------------
+
+def test_cancel_without_submit_raises(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+
+    with pytest.raises(RuntimeError, match="No circuit was sent before calling cancel"):
+        job.cancel()
+
+
+def test_cancel_pending_job_marks_it_cancelled(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = Mock(job_id="7")
+    job._future.get.return_value = json.dumps({"CANCELLED": "The task was cancelled."})
+
+    assert job.cancel() is True
+    qclient_mock.cancel.assert_called_once_with("7")
+    with pytest.raises(RuntimeError, match="cancelled"):
+        job.result
+
+
+def test_cancel_finished_job_keeps_result(qclient_mock, default_device, circuit_ir):
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = Mock(job_id="7")
+    job._future.get.return_value = json.dumps({"counts": {"00": 10}, "time_taken": 0.1})
+
+    assert job.cancel() is False
+    assert job._updated is True
+    assert job.result.counts == {"00": 10}
+
+# ------------------------------
+# Parameter expressions
+# ------------------------------
+
+def _expression_param(expr, names):
+    param = MagicMock(spec=Param)
+    param.expr = expr
+    param.variables = [Mock() for _ in names]
+    for symbol, name in zip(param.variables, names):
+        symbol.name = name
+    return param
+
+def test_qjob_sends_param_expressions(qclient_mock, circuit_ir, default_device):
+    circuit_ir["params"] = [_expression_param("2*theta", ["theta"]), 
+                            _expression_param("theta + sin(phi)", ["theta", "phi"])]
+
+    job = QJob(qclient_mock, default_device, circuit_ir)
+
+    assert job._quantum_task["param_expressions"] == {
+        "variables": ["phi", "theta"],
+        "expressions": ["2*theta", "theta + sin(phi)"]
+    }
+
+def test_qjob_unknown_function_disables_param_expressions(qclient_mock, circuit_ir, default_device):
+    circuit_ir["params"] = [_expression_param("besselj(0, theta)", ["theta"])]
+
+    job = QJob(qclient_mock, default_device, circuit_ir)
+
+    assert "param_expressions" not in job._quantum_task
+
+def test_upgrade_with_all_variables_sends_only_variables(qclient_mock, circuit_ir, default_device):
+    param = _expression_param("2*theta + phi", ["theta", "phi"])
+    circuit_ir["params"] = [param]
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._result = Mock()
+
+    job.upgrade_parameters({"theta": 0.5, "phi": 1})
+
+    qclient_mock.send_parameters.assert_called_once_with('{"variables": [1.0, 0.5]}')
+    param.eval.assert_not_called()
+
+def test_upgrade_with_some_variables_evaluates_in_client(qclient_mock, circuit_ir, default_device):
+    param = _expression_param("2*theta + phi", ["theta", "phi"])
+    param.value = 1.0
+    param.__float__ = Mock(return_value=1.0)
+    circuit_ir["params"] = [param]
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._result = Mock()
+
+    job.upgrade_parameters({"theta": 0.5, "phi": 1})
+    job.upgrade_parameters({"theta": 0.7})
+
+    # The values computed by the vQPU are brought to the client before the partial update
+    param.eval.assert_called_once_with({"phi": 1, "theta": 0.5})
+    assert json.loads(qclient_mock.send_parameters.call_args[0][0]) == {"params": [1.0]}
+
+# ------------------------------
+# Batches of parameter sets
+# ------------------------------
+
+def test_upgrade_with_list_of_lists_sends_batch(qclient_mock, circuit_ir, default_device):
+    circuit_ir["params"] = [_expression_param("theta", ["theta"]), _expression_param("phi", ["phi"])]
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._result = Mock()
+
+    job.upgrade_parameters([[0.1, 0.2], [0.3, 0.4]], shots=[10, 20])
+
+    message = json.loads(qclient_mock.send_parameters.call_args[0][0])
+    assert message == {"batch": {"params": [[0.1, 0.2], [0.3, 0.4]], "shots": [10, 20]}}
+
+def test_batch_with_wrong_set_size_raises(qclient_mock, circuit_ir, default_device):
+    circuit_ir["params"] = [_expression_param("theta", ["theta"]), _expression_param("phi", ["phi"])]
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._result = Mock()
+
+    with pytest.raises(ValueError):
+        job.upgrade_parameters([[0.1, 0.2], [0.3]])
+
+def test_batch_result_is_a_list(monkeypatch, qclient_mock, circuit_ir, default_device):
+    future_mock = Mock()
+    future_mock.get.return_value = json.dumps({"batch": [{"counts": {"0": 1}}, {"counts": {"1": 1}}]})
+    result_mock = Mock(side_effect=lambda res, **kwargs: res["counts"])
+    monkeypatch.setattr(qjob_mod, "Result", result_mock)
+
+    job = QJob(qclient_mock, default_device, circuit_ir)
+    job._future = future_mock
+
+    assert job.result == [{"0": 1}, {"1": 1}]
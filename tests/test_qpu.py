@@ -434,6 +434,31 @@ def test_qraise_builds_full_command_with_all_options_and_family_tuple_return(mon
     assert result == family
 
 
+@pytest.mark.parametrize("kwargs, options", [
+    (dict(cores=4, workers=2, max_queued_jobs=100, max_queued_mb=512),
+     "--cores=4 --workers=2 --max-queued-jobs=100 --max-queued-mb=512"),
+    (dict(result_cache_entries=256, result_cache_mb=32),
+     "--result-cache-entries=256 --result-cache-mb=32"),
+    (dict(coalesce_jobs=8), "--coalesce-jobs=8"),
+    (dict(classical_comm=True, shot_lanes=16), "--classical_comm --shot-lanes=16"),
+])
+def test_qraise_adds_qpu_settings_options(monkeypatch, kwargs, options):
+    n, t = 1, "00:10:00"
+
+    monkeypatch.setattr(qpu_mod.os.path, "exists", lambda _: True)
+    monkeypatch.setattr("builtins.open", mock_open())
+    monkeypatch.setattr(qpu_mod.json, "load", Mock(return_value={"12345-0": {}}))
+
+    run_mock = Mock()
+    run_mock.side_effect = _subprocess_run_side_effect_ok("12345")
+    monkeypatch.setattr(qpu_mod.subprocess, "run", run_mock)
+
+    qraise(n, t, co_located=False, **kwargs)
+
+    (cmd_str,), _ = run_mock.call_args_list[0]
+    assert cmd_str == f"qraise -n {n} -t {t} {options}"
+
+
 # --- QPUS_FILEPATH creation ---
 
 def test_qraise_creates_qpus_file_if_not_exists(monkeypatch):
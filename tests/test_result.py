@@ -26,6 +26,10 @@ def test_result_init_raises_on_error_key():
     with pytest.raises(RuntimeError) as excinfo:
         Result({"ERROR": "no backend"}, circ_id="c1", registers={"c": [0]})
 
+def test_result_init_raises_on_busy_key():
+    with pytest.raises(RuntimeError) as excinfo:
+        Result({"BUSY": "queue full", "retry_after_ms": 100}, circ_id="c1", registers={"c": [0]})
+
 def test_counts_from_results_key():
     result_dict = {
         "results": [